@@ -0,0 +1,59 @@
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+
+namespace {
+thread_local uint64_t n_thread_allocations = 0;
+
+void* Allocate(size_t size) {
+  ++n_thread_allocations;
+  return malloc(size > 0 ? size : 1);
+}
+}  // namespace
+
+uint64_t AllocationCounter::GetThreadCount() { return n_thread_allocations; }
+
+void* operator new(size_t size) {
+  void* memory = Allocate(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](size_t size) {
+  void* memory = Allocate(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+
+void operator delete[](void* memory) noexcept { free(memory); }
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  free(memory);
+}
+
+#else
+
+uint64_t AllocationCounter::GetThreadCount() { return 0; }
+
+#endif
@@ -0,0 +1,33 @@
+// Counts heap allocations made through the global operator new, so that the
+// frame loop can report how many it makes per frame. Debug builds (without
+// NDEBUG) replace the global operator new and delete to count; release builds
+// leave them alone and report nothing.
+//
+// Counts are kept per thread, so the scene loader and watcher threads do not
+// show up in the frames of the render thread. Memory that Anvil, GLFW or the
+// Vulkan driver get from malloc directly is not counted.
+
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+#ifndef NDEBUG
+#define COUNT_ALLOCATIONS
+#endif
+
+class AllocationCounter {
+ public:
+  static bool IsEnabled() {
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Allocations made by the calling thread so far.
+  static uint64_t GetThreadCount();
+};
+
+#endif  // ALLOCATION_COUNTER_H_
@@ -1,6 +1,10 @@
 // Imports.
 #include "app.h"
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -34,7 +38,9 @@
 #include "wrappers/swapchain.h"
 #include "vulkan/vulkan.h"
 #include "matrix.h"
+#include "allocation_counter.h"
 #include "callback.h"
+#include "scene_stream.h"
 #include "glm/gtc/matrix_transform.hpp"
 #ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
@@ -52,17 +58,99 @@
 #define DEBUG_REREAD 0
 #define DEBUG_FRAME_TIME 0
 #define DEBUG_BAKE_TIME 1
+#define PROFILE_REPORT_INTERVAL 600
+
+// Blocks of a loading scene added per frame, 4 MiB of centers.
+#define SCENE_BLOCKS_PER_FRAME (1 << 18)
+
+// Bytes of block centers staged for upload at a time by each frame in
+// flight and outside frames, a frame's worth of a loading scene.
+#define STAGING_SECTION_SIZE (sizeof(glm::vec4) * SCENE_BLOCKS_PER_FRAME)
+
+// Most slots in a chunk of GPU storage, 144 MiB of solid vertices. Devices
+// with a smaller maxStorageBufferRange get smaller chunks.
+#define MAX_CHUNK_MESHES (1 << 16)
+
+// Furthest block that can be placed or removed, in blocks.
+#define MAX_EDIT_DISTANCE 8.0f
+
+// Positions of the blocks that are not empty.
+static std::vector<glm::ivec4> solid_positions(
+	const std::vector<Terrain::Block*>& blocks) {
+	std::vector<glm::ivec4> positions;
+	for (Terrain::Block* block : blocks) {
+		if (block->GetType() > 0) {
+			positions.push_back(block->GetPos());
+		}
+	}
+	return positions;
+}
+
+// Arguments of the indirect compute dispatch and draw for one swapchain
+// image. The compute shader reads n_meshes and chunk_offset, the chunk's
+// origin relative to the eye, from the same memory, laid out as a std140
+// uniform block.
+struct DrawArguments {
+	VkDispatchIndirectCommand dispatch;
+	uint32_t n_meshes;
+	VkDrawIndirectCommand draw;
+	glm::vec4 chunk_offset;
+};
+
+// Write a 5x5 matrix in the layout of the shaders' uniform blocks: the 4x4
+// part, the last column, the last row and the bottom right element.
+static void write_mat5(unsigned char* destination, const mat5& matrix) {
+	memcpy(destination, &matrix.get_main_mat(), sizeof(glm::mat4));
+	destination += sizeof(glm::mat4);
+	memcpy(destination, &matrix.get_column(), sizeof(glm::vec4));
+	destination += sizeof(glm::vec4);
+	memcpy(destination, &matrix.get_row(), sizeof(glm::vec4));
+	destination += sizeof(glm::vec4);
+	memcpy(destination, &matrix.get_ww(), sizeof(float));
+}
 
 /*
  *	Create the app and assign default values to several field variables.
  */
-App::App(int width, int height, std::vector<Terrain::Block*> blocks)
+App::App(int width, int height, std::vector<Terrain::Block*> blocks,
+	const AppOptions& options)
+	: App(width, height, solid_positions(blocks), options) {}
+
+App::App(int width, int height, std::unique_ptr<SceneLoader> scene_loader,
+	const AppOptions& options)
+	: App(width, height, std::vector<glm::ivec4>(), options) {
+	scene_loader_ = std::move(scene_loader);
+}
+
+App::App(int width, int height, std::vector<glm::ivec4> block_positions,
+	const AppOptions& options)
 	: windowWidth_(width),
 	windowHeight_(height),
-	blocks_(blocks),
+	block_positions_(std::move(block_positions)),
 	n_last_semaphore_used_(0),
 	n_swapchain_images_(N_SWAPCHAIN_IMAGES),
+	options_(options),
+	has_unbaked_buffers_(false),
+	has_unbaked_mapped_buffers_(false),
+	n_frame_allocations_(0),
+	device_chunk_meshes_(0),
+	viewProjMapped_(nullptr),
+	viewMatrixMapped_(nullptr),
+	drawArgumentsMapped_(nullptr),
 	prev_time(std::chrono::steady_clock::now()) {
+	if (!options_.gpu_profile_log.empty()) {
+		options_.gpu_profile = true;
+	}
+	if (!options_.frame_stats_log.empty()) {
+		options_.frame_stats = true;
+	}
+	if (options_.headless || !options_.camera_path.empty()) {
+		options_.frame_stats = true;
+	}
+	options_.frames_in_flight = std::min(std::max(options_.frames_in_flight, 1u),
+		static_cast<uint32_t>(N_SWAPCHAIN_IMAGES));
+	frame_limiter_.SetMaxFps(options_.max_fps);
+	input_latency_.SetEnabled(options_.input_latency && !options_.headless);
 }
 
 /*
@@ -73,12 +161,23 @@ App::App(int width, int height, std::vector<Terrain::Block*> blocks)
  https://github.com/GPUOpen-LibrariesAndSDKs/Anvil/blob/master/examples/PushConstants
  */
 void App::init() {
+	StartupTimer* startup_timer = StartupTimer::GetInstance();
+	if (scene_loader_) {
+		scene_loader_->Start();
+	}
+	startup_timer->Begin(StartupTimer::PHASE_UPLOAD);
 	init_meshes();
+	startup_timer->End(StartupTimer::PHASE_UPLOAD);
+	startup_timer->Begin(StartupTimer::PHASE_VULKAN);
 	init_vulkan();
 	init_window();
 	init_swapchain();
+	init_profiler();
+	startup_timer->End(StartupTimer::PHASE_VULKAN);
 	printf("s1\n");
+	startup_timer->Begin(StartupTimer::PHASE_UPLOAD);
 	init_buffers();
+	startup_timer->End(StartupTimer::PHASE_UPLOAD);
 	printf("s2\n");
 	init_dsgs();
 	printf("s3\n");
@@ -86,9 +185,14 @@ void App::init() {
 	printf("s4\n");
 	init_semaphores();
 	printf("s5\n");
+	startup_timer->Begin(StartupTimer::PHASE_SHADERS);
 	init_shaders();
+	startup_timer->End(StartupTimer::PHASE_SHADERS);
 	printf("s6\n");
 
+	// Graphics pipelines are baked lazily when the command buffers that use
+	// them are recorded, so those count towards the pipeline phase as well.
+	startup_timer->Begin(StartupTimer::PHASE_PIPELINES);
 	init_compute_pipelines();
 	printf("s7\n");
 	init_framebuffers();
@@ -96,9 +200,22 @@ void App::init() {
 	init_gfx_pipelines();
 	printf("s9\n");
 	init_command_buffers();
+	startup_timer->End(StartupTimer::PHASE_PIPELINES);
 
 	printf("s10\n");
 	init_camera();
+
+	// Headless runs and camera path replays are benchmarks, which need the
+	// same scene in every frame.
+	if (scene_loader_ && (options_.headless || IsReplaying())) {
+		startup_timer->Begin(StartupTimer::PHASE_UPLOAD);
+		while (!append_scene_blocks(SIZE_MAX, true)) {
+		}
+		reserve_block_slots();
+		upload_block_slots();
+		staging_uploader_.Flush();
+		startup_timer->End(StartupTimer::PHASE_UPLOAD);
+	}
 }
 
 /*
@@ -106,22 +223,206 @@ void App::init() {
  *	Initialize the vector of tesseract centers given the input terrain data.
  */
 
- // Prepare the actual values of input mesh data.
- // Some preconfigured testing scenes are available in shapes.h.
-std::vector<glm::vec4> MESH_CENTERS;
-
 // Set to 64 for wire mesh, 144 for closed figure.
 int N_VERTICES = 144;
+
+// Slots of the input buffers the GPU processes, and slots the buffers and
+// shaders have room for. They differ while a scene is loading in the
+// background or after blocks were edited, and because every chunk only holds
+// blocks of one region; see BlockSlots.
 int N_MESHES = 0;
+int MAX_MESHES = 1;
+
+// Slots per chunk of GPU storage; see App::SceneChunk.
+int CHUNK_MESHES = 1;
 
+// Size the scene for the blocks the app was created with and the blocks still
+// loading. The blocks are placed in their slots by init_buffers(), once the
+// size of a chunk is known.
 void App::init_meshes() {
-	for (int i = 0; i < blocks_.size(); i++) {
-		Terrain::Block* block = blocks_.at(i);
-		if (block->GetType() > 0) {
-			MESH_CENTERS.push_back(block->GetPos());
+	MAX_MESHES = static_cast<int>(std::min<size_t>(block_positions_.size(),
+		INT_MAX));
+	if (scene_loader_) {
+		MAX_MESHES = static_cast<int>(std::min<uint64_t>(
+			MAX_MESHES + scene_loader_->GetCapacity(), INT_MAX));
+	}
+	MAX_MESHES = std::max(MAX_MESHES, 1);
+	block_slots_.Reserve(MAX_MESHES);
+	N_VERTICES = options_.wireframe ? 64 : 144;
+}
+
+/*
+ *	Move up to max_blocks blocks from the scene loader into the scene, waiting
+ *	for the loader first if asked to. Returns true once the whole scene is in.
+ *	The blocks take their slots like edits, and are uploaded with them.
+ */
+bool App::append_scene_blocks(size_t max_blocks, bool wait) {
+	if (!scene_loader_) {
+		return true;
+	}
+	size_t n_blocks = scene_loader_->Take(max_blocks, &scene_batch_, wait);
+	if (n_blocks > 0) {
+		block_slots_.Append(scene_batch_.data(), n_blocks);
+		std::unique_lock<std::mutex> lock = simulation_.LockCamera();
+		camera_.AddTerrain(scene_batch_.data(), n_blocks);
+		if (options_.watch_scene && !options_.headless &&
+			!scene_loader_->GetPath().empty()) {
+			loaded_scene_.insert(loaded_scene_.end(), scene_batch_.begin(),
+				scene_batch_.begin() + n_blocks);
+		}
+	}
+	if (!scene_loader_->IsDone()) {
+		return false;
+	}
+	if (!scene_loader_->Succeeded()) {
+		printf("Scene loading failed; showing the %zu blocks loaded.\n",
+			block_slots_.GetBlockCount());
+	}
+	StartupTimer::GetInstance()->MarkSceneLoaded();
+	printf("Scene loaded: %zu blocks after %.1f ms.\n",
+		block_slots_.GetBlockCount(),
+		StartupTimer::GetInstance()->GetMs(StartupTimer::PHASE_SCENE_LOADED));
+	if (options_.watch_scene && !options_.headless) {
+		if (scene_loader_->GetPath().empty()) {
+			printf("Only scene files can be watched.\n");
+		} else if (scene_loader_->Succeeded()) {
+			printf("Watching %s for changes.\n", scene_loader_->GetPath().c_str());
+			scene_watcher_.reset(new SceneWatcher(scene_loader_->GetPath()));
+			scene_watcher_->Start(std::move(loaded_scene_));
+		}
+	}
+	scene_loader_.reset();
+	std::vector<glm::vec4>().swap(scene_batch_);
+	std::vector<glm::ivec4>().swap(loaded_scene_);
+	return true;
+}
+
+/*
+ *	Apply the patches of every reload of the watched scene file since the last
+ *	frame, as if the changed blocks had been edited. Their slots are uploaded
+ *	together with the other edits by the next frame.
+ */
+void App::apply_scene_patches() {
+	if (!scene_watcher_) {
+		return;
+	}
+	SceneWatcher::Patch patch;
+	while (scene_watcher_->TakePatch(&patch)) {
+		auto start = std::chrono::steady_clock::now();
+		for (const glm::ivec4& position : patch.removed) {
+			remove_block(position);
+		}
+		for (const glm::ivec4& position : patch.added) {
+			place_block(position);
+		}
+		printf("Reloaded %s: %zu blocks added, %zu removed, %zu in the scene. "
+			"Parsed in %.1f ms, applied in %.1f ms.\n",
+			scene_watcher_->GetPath().c_str(), patch.added.size(),
+			patch.removed.size(), block_slots_.GetBlockCount(), patch.ms,
+			std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+/*
+ *	BLOCK EDITING.
+ *	Blocks are placed and removed one slot at a time, and the slots changed
+ *	since the last frame are uploaded before the next one.
+ */
+void App::place_block(const glm::ivec4& position) {
+	if (block_slots_.Add(position)) {
+		glm::vec4 center(position);
+		std::unique_lock<std::mutex> lock = simulation_.LockCamera();
+		camera_.AddTerrain(&center, 1);
+	}
+}
+
+void App::remove_block(const glm::ivec4& position) {
+	if (block_slots_.Remove(position)) {
+		glm::vec4 center(position);
+		std::unique_lock<std::mutex> lock = simulation_.LockCamera();
+		camera_.RemoveTerrain(&center, 1);
+	}
+}
+
+// Removes the block the view is centered on.
+void App::RemoveTargetBlock() {
+	glm::ivec4 block, before;
+	bool has_target;
+	{
+		std::unique_lock<std::mutex> lock = simulation_.LockCamera();
+		has_target = camera_.FindTarget(MAX_EDIT_DISTANCE, &block, &before);
+	}
+	if (has_target) {
+		remove_block(block);
+	}
+}
+
+// Places a block against the face of the block the view is centered on.
+void App::PlaceTargetBlock() {
+	glm::ivec4 block, before;
+	bool has_target;
+	{
+		std::unique_lock<std::mutex> lock = simulation_.LockCamera();
+		has_target = camera_.FindTarget(MAX_EDIT_DISTANCE, &block, &before) &&
+			!camera_.OverlapsCell(before);
+	}
+	if (has_target) {
+		place_block(before);
+	}
+}
+
+// Make room for the chunks of the slots placed since the last frame, before
+// the frame uploads them. Only this waits for the frames in flight, and only
+// when chunks have to be added.
+void App::reserve_block_slots() {
+	if (block_slots_.GetChunkCount() <= scene_chunks_.size()) {
+		return;
+	}
+
+	// Leave room for the blocks still loading, and to grow, so that further
+	// blocks are written in place again.
+	size_t n_slots = block_slots_.GetChunkCount() * CHUNK_MESHES;
+	if (scene_loader_) {
+		n_slots += static_cast<size_t>(scene_loader_->GetRemainingCapacity());
+	}
+	n_slots += n_slots / 2;
+	if (CHUNK_MESHES < device_chunk_meshes_) {
+		// The chunks were sized for a smaller scene, so start over with larger
+		// ones, which lays the slots out again and uploads all of them.
+		MAX_MESHES = static_cast<int>(std::min<size_t>(n_slots, INT_MAX));
+		recreate_rendering();
+		return;
+	}
+
+	// The descriptor sets and command buffers of the frames in flight are
+	// rebuilt.
+	vkDeviceWaitIdle(device_ptr_.lock()->get_device_vk());
+	grow_scene_chunks(n_slots);
+}
+
+// Stage the slots changed since the last frame, each run of consecutive
+// slots as one copy region, and process the new slots from now on. Called
+// between staging_uploader_.BeginFrame() and EndFrame(), so the copies are
+// submitted with the frame and ordered after the reads of earlier frames
+// instead of waiting for them.
+void App::upload_block_slots() {
+	block_slots_.TakeDirtySlots(&dirty_slots_);
+	if (dirty_slots_.empty()) {
+		return;
+	}
+	const std::vector<glm::vec4>& centers = block_slots_.GetCenters();
+	size_t first = 0;
+	while (first < dirty_slots_.size()) {
+		size_t last = first + 1;
+		while (last < dirty_slots_.size() &&
+			dirty_slots_[last] == dirty_slots_[last - 1] + 1) {
+			++last;
 		}
+		write_slots(dirty_slots_[first], last - first, &centers[dirty_slots_[first]]);
+		first = last;
 	}
-	N_MESHES = MESH_CENTERS.size();
+	N_MESHES = static_cast<int>(block_slots_.GetSlotCount());
 }
 
 /*
@@ -140,6 +441,15 @@ void App::init_vulkan() {
 	device_ptr_ = Anvil::SGPUDevice::create(
 		physical_device_ptr_, Anvil::DeviceExtensionConfiguration(),
 		std::vector<std::string>(), false, false);
+
+	// All buffers come from one allocator, which suballocates device memory
+	// blocks, so chunks and edits can be allocated one at a time.
+	memory_allocator_ = Anvil::MemoryAllocator::create_vma(device_ptr_);
+	mapped_memory_allocator_ = Anvil::MemoryAllocator::create_vma(device_ptr_);
+	mapped_buffers_.Init(device_ptr_);
+	memory_budget_.Init(device_ptr_);
+	printf("Memory budget reporting: %s\n",
+		memory_budget_.HasBudget() ? "VK_EXT_memory_budget" : "app buffers only");
 }
 
 /*
@@ -147,6 +457,17 @@ void App::init_vulkan() {
   Initialize the window for displaying this app.
  */
 void App::init_window() {
+	if (options_.headless) {
+		// Render into offscreen images through Anvil's dummy window, which
+		// calls draw_frame() from its own loop and can store PNG snapshots.
+		window_ptr_ = Anvil::WindowFactory::create_window(
+			options_.snapshots ? Anvil::WINDOW_PLATFORM_DUMMY_WITH_PNG_SNAPSHOTS
+			                   : Anvil::WINDOW_PLATFORM_DUMMY,
+			options_.snapshots ? options_.snapshot_prefix : APP_NAME,
+			windowWidth_, windowHeight_, draw_frame, this);
+		return;
+	}
+
 	InitializeWindow(windowWidth_, windowHeight_, APP_NAME);
 
 #ifdef _WIN32
@@ -174,9 +495,24 @@ void App::init_swapchain() {
 
 	rendering_surface_ptr_->set_name("Main rendering surface");
 
+	// FIFO is the only presentation mode every surface has to support. The
+	// headless dummy swapchain presents nothing, so it keeps FIFO as well.
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	if (!options_.headless) {
+		bool is_supported = false;
+		if (rendering_surface_ptr_->supports_presentation_mode(
+			physical_device_ptr_, options_.present_mode, &is_supported) &&
+			is_supported) {
+			present_mode = options_.present_mode;
+		} else {
+			printf("Presentation mode %d is not supported, using FIFO\n",
+				static_cast<int>(options_.present_mode));
+		}
+	}
+
 	swapchain_ptr_ = device_locked_ptr->create_swapchain(
 		rendering_surface_ptr_, window_ptr_, VK_FORMAT_B8G8R8A8_UNORM,
-		VK_PRESENT_MODE_FIFO_KHR, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		present_mode, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 		n_swapchain_images_);
 	swapchain_ptr_->set_name("Main swapchain");
 
@@ -199,97 +535,61 @@ void App::init_swapchain() {
 
  // Buffer initialization.
 void App::init_buffers() {
-	// Setup the memory allocator to begin initializing data buffers.
-	std::shared_ptr<Anvil::MemoryAllocator> memory_allocator_ptr;
+	// The buffers written every frame are about to be replaced.
+	mapped_buffers_.Clear();
+
+	// The staging buffer outlives the chunks it uploads to.
+	if (!staging_buffer_) {
+		staging_buffer_ = Anvil::Buffer::create_nonsparse(
+			device_ptr_, StagingUploader::GetStagingSize(STAGING_SECTION_SIZE,
+				N_SWAPCHAIN_IMAGES),
+			Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+			VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+		staging_buffer_->set_name("Staging buffer");
+		add_buffer(staging_buffer_, Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+		bake_buffers();
+
+		// The compute shader reads the centers, and the axis pass binds the
+		// first chunk as a vertex buffer.
+		staging_uploader_.Init(device_ptr_, staging_buffer_->get_buffer(),
+			STAGING_SECTION_SIZE, N_SWAPCHAIN_IMAGES,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
 	std::shared_ptr<Anvil::PhysicalDevice> physical_device_locked_ptr(
 		physical_device_ptr_);
-	const VkDeviceSize sb_data_alignment_requirement =
+	const VkDeviceSize max_storage_buffer_range =
 		physical_device_locked_ptr->get_device_properties()
-		.limits.minStorageBufferOffsetAlignment;
-	memory_allocator_ptr = Anvil::MemoryAllocator::create_oneshot(device_ptr_);
-
-	// NEW: cube.
-	// Figure out what size is needed for the input buffer of cube vertices.
-	totalInputCubeBufferSize_ = 0;
-	for (uint32_t vertexIndex = 0; vertexIndex < N_MESHES; ++vertexIndex) {
-		// Store current data offset.
-		anvil_assert((totalInputCubeBufferSize_ % sb_data_alignment_requirement) ==
-			0);
-
-		// Tim's platform has different offsets?
-#ifdef _WIN32
-		inputCubeElementOffsets_.push_back(totalInputCubeBufferSize_ / 2);
-#else
-		inputCubeElementOffsets_.push_back(totalInputCubeBufferSize_);
-#endif
-
-		// Account for space necessary to hold a vec4 and any padding required to
-		// meet the alignment requirement.
-		totalInputCubeBufferSize_ += (sizeof(float) * 4);
-		totalInputCubeBufferSize_ +=
-			(sb_data_alignment_requirement -
-				totalInputCubeBufferSize_ % sb_data_alignment_requirement) %
-			sb_data_alignment_requirement;
-	}
-
-	// Create the layout buffer for storing the input cube vertices.
-	inputCubeBufferPointer_ = Anvil::Buffer::create_nonsparse(
-		device_ptr_, totalInputCubeBufferSize_,
-		Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
-		VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	inputCubeBufferPointer_->set_name("Cube input vertices");
-	memory_allocator_ptr->add_buffer(inputCubeBufferPointer_, 0);
-
-	std::unique_ptr<char> inputCubeBufferValues;
-	inputCubeBufferValues.reset(
-		new char[static_cast<uintptr_t>(totalInputCubeBufferSize_)]);
-	for (uint32_t vertexIndex = 0; vertexIndex < N_MESHES; ++vertexIndex) {
-		float* cubeVertexDataPointer =
-			(float*)(inputCubeBufferValues.get() +
-				inputCubeElementOffsets_[vertexIndex]);
-
-		// Populate the component coordinates for each input vertex.
-		glm::vec4 vertex = MESH_CENTERS[vertexIndex];
-		*cubeVertexDataPointer = vertex.x;
-		cubeVertexDataPointer++;
-		*cubeVertexDataPointer = vertex.y;
-		cubeVertexDataPointer++;
-		*cubeVertexDataPointer = vertex.z;
-		cubeVertexDataPointer++;
-		*cubeVertexDataPointer = vertex.w;
-	}
-
-	// Now prepare a memory block which is going to hold vertex data generated by
-	// the compute shader:
-	outputCubeVerticesBufferSize_ = 0;
-	for (unsigned int vertexIndex = 0; vertexIndex < (N_MESHES * N_VERTICES); ++vertexIndex) {
-		// Store current offset and account for space necessary to hold it.
-		// Tim's platform has different offsets?
-#ifdef _WIN32
-		outputCubeVerticesBufferSizes_.push_back(outputCubeVerticesBufferSize_ / 2);
-#else
-		outputCubeVerticesBufferSizes_.push_back(outputCubeVerticesBufferSize_);
-#endif
-
-		outputCubeVerticesBufferSize_ += (sizeof(float) * 4);
-
-		// Account for space necessary to hold a vec4 for each point
-		// and any padding required to meet the alignment requirement.
-		outputCubeVerticesBufferSize_ +=
-			(sb_data_alignment_requirement -
-				outputCubeVerticesBufferSize_ % sb_data_alignment_requirement) %
-			sb_data_alignment_requirement;
-		anvil_assert(
-			outputCubeVerticesBufferSize_ % sb_data_alignment_requirement == 0);
+		.limits.maxStorageBufferRange;
+
+	// Size the chunks so that the output vertices of one fit in a single
+	// storage buffer range, in whole compute workgroups.
+	const VkDeviceSize output_size_per_mesh = sizeof(glm::vec4) * N_VERTICES;
+	VkDeviceSize chunk_meshes = std::min<VkDeviceSize>(
+		max_storage_buffer_range / output_size_per_mesh, MAX_CHUNK_MESHES);
+	chunk_meshes = std::max<VkDeviceSize>(chunk_meshes / 512 * 512, 512);
+	device_chunk_meshes_ = static_cast<int>(chunk_meshes);
+	chunk_meshes = std::min<VkDeviceSize>(chunk_meshes,
+		Anvil::Utils::round_up(static_cast<VkDeviceSize>(MAX_MESHES),
+			static_cast<VkDeviceSize>(512)));
+	CHUNK_MESHES = static_cast<int>(chunk_meshes);
+
+	// Lay the blocks out in chunks of that size, starting with the blocks the
+	// app was created with.
+	block_slots_.SetChunkSlots(CHUNK_MESHES);
+	for (const glm::ivec4& position : block_positions_) {
+		block_slots_.Add(position);
 	}
+	std::vector<glm::ivec4>().swap(block_positions_);
 
-	// Allocate the memory for the buffer of output vertices.
-	outputCubeVerticesBufferPointer_ = Anvil::Buffer::create_nonsparse(
-		device_ptr_, outputCubeVerticesBufferSize_,
-		Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
-		VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-	outputCubeVerticesBufferPointer_->set_name("Cube output vertices");
-	memory_allocator_ptr->add_buffer(outputCubeVerticesBufferPointer_, 0);
+	// NEW: cube.
+	// Create the chunks with room for the whole scene, and fill them with the
+	// blocks loaded so far.
+	scene_chunks_.clear();
+	add_scene_chunks(std::max<size_t>((MAX_MESHES + CHUNK_MESHES - 1) /
+		CHUNK_MESHES, block_slots_.GetChunkCount()));
 
 	// Find size for sroting the 4D view matrix.
 	const auto dynamic_ub_alignment_requirement =
@@ -309,8 +609,7 @@ void App::init_buffers() {
 		Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
 		VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 	viewProjUniformPointer->set_name("View Proj data buffer");
-	memory_allocator_ptr->add_buffer(viewProjUniformPointer,
-		Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+	add_buffer(viewProjUniformPointer, Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
 
 	// Create the layout buffer for storing viewMatrix in the compute shader.
 	viewMatrixUniformPointer = Anvil::Buffer::create_nonsparse(
@@ -318,12 +617,170 @@ void App::init_buffers() {
 		Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
 		VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 	viewMatrixUniformPointer->set_name("View Matrix data buffer");
-	memory_allocator_ptr->add_buffer(viewMatrixUniformPointer,
-		Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+	add_buffer(viewMatrixUniformPointer, Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+	bake_buffers();
+
+	// Upload every slot, including those of edits not uploaded yet.
+	init_draw_arguments();
+	map_frame_buffers();
+	block_slots_.TakeDirtySlots(&dirty_slots_);
+	for (size_t n_chunk = 0; n_chunk < block_slots_.GetChunkCount();
+		++n_chunk) {
+		const size_t first_slot = n_chunk * CHUNK_MESHES;
+		write_slots(first_slot, block_slots_.GetChunkSlotCount(n_chunk),
+			&block_slots_.GetCenters()[first_slot]);
+	}
+	N_MESHES = static_cast<int>(block_slots_.GetSlotCount());
+	staging_uploader_.Flush();
+	memory_budget_.Print();
+}
 
-	// Assign memory blocks to cube input vertices buffer and fill with values.
-	inputCubeBufferPointer_->write(0, inputCubeBufferPointer_->get_size(),
-		inputCubeBufferValues.get());
+// Queue a buffer for allocation by the next bake_buffers(). Mappable buffers
+// are written every frame and are kept mapped, so they come from an allocator
+// of their own.
+void App::add_buffer(const std::shared_ptr<Anvil::Buffer>& buffer,
+	Anvil::MemoryFeatureFlags memory_features) {
+	if ((memory_features & Anvil::MEMORY_FEATURE_FLAG_MAPPABLE) != 0) {
+		mapped_memory_allocator_->add_buffer(buffer,
+			memory_features | Anvil::MEMORY_FEATURE_FLAG_HOST_COHERENT);
+		has_unbaked_mapped_buffers_ = true;
+	} else {
+		memory_allocator_->add_buffer(buffer, memory_features);
+		has_unbaked_buffers_ = true;
+	}
+	unbaked_buffers_.push_back(buffer);
+}
+
+// Allocate the memory of the buffers added since the last bake, and count it
+// in the memory budget.
+void App::bake_buffers() {
+	if (has_unbaked_buffers_) {
+		memory_allocator_->bake();
+	}
+	if (has_unbaked_mapped_buffers_) {
+		mapped_memory_allocator_->bake();
+	}
+	for (const std::shared_ptr<Anvil::Buffer>& buffer : unbaked_buffers_) {
+		memory_budget_.Track(buffer);
+	}
+	unbaked_buffers_.clear();
+	has_unbaked_buffers_ = false;
+	has_unbaked_mapped_buffers_ = false;
+}
+
+// Map the buffers written every frame, and the staging buffer.
+void App::map_frame_buffers() {
+	staging_uploader_.SetStagingData(mapped_buffers_.Map(staging_buffer_));
+	viewProjMapped_ = mapped_buffers_.Map(viewProjUniformPointer);
+	viewMatrixMapped_ = mapped_buffers_.Map(viewMatrixUniformPointer);
+	drawArgumentsMapped_ = mapped_buffers_.Map(drawArgumentsBufferPointer_);
+}
+
+// Append chunks with buffers of input cube centers and output cube vertices.
+// The compute shader reads the centers as a tightly packed vec4 array, the
+// same layout as the slots of block_slots_, and writes the vertices as
+// another.
+void App::add_scene_chunks(size_t n_chunks) {
+	const VkDeviceSize chunk_meshes = CHUNK_MESHES;
+	const size_t first_chunk = scene_chunks_.size();
+	scene_chunks_.resize(first_chunk + n_chunks);
+	for (size_t n_chunk = first_chunk; n_chunk < scene_chunks_.size();
+		++n_chunk) {
+		SceneChunk& chunk = scene_chunks_[n_chunk];
+		chunk.input_buffer = Anvil::Buffer::create_nonsparse(
+			device_ptr_, sizeof(glm::vec4) * chunk_meshes,
+			Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+			VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		chunk.input_buffer->set_name("Cube input vertices");
+		add_buffer(chunk.input_buffer, 0);
+
+		chunk.output_buffer = Anvil::Buffer::create_nonsparse(
+			device_ptr_, sizeof(glm::vec4) * N_VERTICES * chunk_meshes,
+			Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+			VK_SHARING_MODE_CONCURRENT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		chunk.output_buffer->set_name("Cube output vertices");
+		add_buffer(chunk.output_buffer, 0);
+	}
+	bake_buffers();
+}
+
+// Create the buffer of dispatch and draw arguments of every chunk, which the
+// compute shader also reads its block count from.
+void App::init_draw_arguments() {
+	const VkDeviceSize dynamic_ub_alignment_requirement =
+		device_ptr_.lock()
+		->get_physical_device_properties()
+		.limits.minUniformBufferOffsetAlignment;
+	drawArgumentsStride_ = Anvil::Utils::round_up(
+		static_cast<VkDeviceSize>(sizeof(DrawArguments)),
+		dynamic_ub_alignment_requirement);
+	drawArgumentsSizePerSwapchain_ = drawArgumentsStride_ * scene_chunks_.size();
+	draw_arguments_.assign(drawArgumentsSizePerSwapchain_, 0);
+	drawArgumentsBufferPointer_ = Anvil::Buffer::create_nonsparse(
+		device_ptr_, drawArgumentsSizePerSwapchain_ * N_SWAPCHAIN_IMAGES,
+		Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+		VK_SHARING_MODE_CONCURRENT,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	drawArgumentsBufferPointer_->set_name("Draw arguments buffer");
+	add_buffer(drawArgumentsBufferPointer_, Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+	bake_buffers();
+}
+
+// Make room for at least n_slots slots by appending chunks, while frames are
+// not in flight. The buffers of the existing chunks are kept; only the draw
+// arguments, the descriptor sets of the chunks and the command buffers are
+// rebuilt.
+void App::grow_scene_chunks(size_t n_slots) {
+	const size_t first_chunk = scene_chunks_.size();
+	const size_t n_chunks = (n_slots + CHUNK_MESHES - 1) / CHUNK_MESHES;
+	if (n_chunks <= first_chunk) {
+		return;
+	}
+	add_scene_chunks(n_chunks - first_chunk);
+	mapped_buffers_.Clear();
+	init_draw_arguments();
+	map_frame_buffers();
+	for (size_t n_chunk = 0; n_chunk < scene_chunks_.size(); ++n_chunk) {
+		SceneChunk& chunk = scene_chunks_[n_chunk];
+		if (n_chunk >= first_chunk) {
+			chunk.compute_dsg = Anvil::DescriptorSetGroup::create(compute_dsg_ptr_,
+				false /* releaseable_sets */);
+			chunk.dsg = Anvil::DescriptorSetGroup::create(dsg_ptr_,
+				false /* releaseable_sets */);
+		}
+		init_chunk_dsgs(&chunk);
+	}
+	MAX_MESHES = static_cast<int>(std::min<size_t>(
+		scene_chunks_.size() * CHUNK_MESHES, INT_MAX));
+	init_command_buffers();
+	memory_budget_.Print();
+}
+
+// Write the centers of n_slots slots, starting at first_slot, into the input
+// buffers of the chunks they fall in, relative to the origins of the chunks.
+// Free slots keep their FREE_SLOT coordinates. The centers are only staged;
+// within a frame they are copied by the frame's submission, otherwise by the
+// next staging_uploader_.Flush().
+void App::write_slots(size_t first_slot, size_t n_slots,
+	const glm::vec4* centers) {
+	while (n_slots > 0) {
+		const size_t n_chunk = first_slot / CHUNK_MESHES;
+		const size_t offset = first_slot % CHUNK_MESHES;
+		const size_t n = std::min<size_t>(n_slots, CHUNK_MESHES - offset);
+		const SceneChunk& chunk = scene_chunks_[n_chunk];
+		const glm::vec4 origin(block_slots_.GetChunkOrigin(n_chunk));
+		relative_centers_.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			relative_centers_[i] = centers[i].x == BlockSlots::kFreeCoordinate
+				? centers[i] : centers[i] - origin;
+		}
+		staging_uploader_.Write(chunk.input_buffer->get_buffer(),
+			sizeof(glm::vec4) * offset, relative_centers_.data(),
+			sizeof(glm::vec4) * n);
+		first_slot += n;
+		n_slots -= n;
+		centers += n;
+	}
 }
 
 /*
@@ -342,6 +799,12 @@ void App::init_dsgs() {
 		1, /* n_elements */
 		VK_SHADER_STAGE_COMPUTE_BIT);
 
+	// The draw arguments of the frame, for the number of blocks.
+	compute_dsg_ptr_->add_binding(0, /* n_set      */
+		1, /* binding    */
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		1, /* n_elements */
+		VK_SHADER_STAGE_COMPUTE_BIT);
 	printf("dsg1\n");
 	compute_dsg_ptr_->add_binding(1,  // Set.
 		0,  // Binding.
@@ -356,62 +819,119 @@ void App::init_dsgs() {
 		1,  // n elements.
 		VK_SHADER_STAGE_COMPUTE_BIT);
 
+	if (pipeline_stats_.HasCounters()) {
+		compute_dsg_ptr_->add_binding(1,  // Set.
+			2,  // Binding.
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+			1,  // n elements.
+			VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+
+	/* Set up the descriptor set layout for the renderer program.  */
+	dsg_ptr_ = Anvil::DescriptorSetGroup::create(device_ptr_,
+		false, /* releaseable_sets */
+		1 /* n_sets           */);
+
+	dsg_ptr_->add_binding(0,                                    /* n_set      */
+		0,                                    /* binding    */
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, /* n_elements */
+		VK_SHADER_STAGE_VERTEX_BIT);
+
+	if (pipeline_stats_.HasCounters()) {
+		dsg_ptr_->add_binding(0, /* n_set      */
+			1,                   /* binding    */
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, /* n_elements */
+			VK_SHADER_STAGE_GEOMETRY_BIT);
+	}
+
+	// Every chunk binds its own buffers to descriptor sets of the layouts
+	// above. The first chunk uses the groups the pipelines are created with,
+	// the others groups derived from them.
+	for (size_t n_chunk = 0; n_chunk < scene_chunks_.size(); ++n_chunk) {
+		SceneChunk& chunk = scene_chunks_[n_chunk];
+		chunk.compute_dsg = n_chunk == 0 ? compute_dsg_ptr_ :
+			Anvil::DescriptorSetGroup::create(compute_dsg_ptr_,
+				false /* releaseable_sets */);
+		chunk.dsg = n_chunk == 0 ? dsg_ptr_ :
+			Anvil::DescriptorSetGroup::create(dsg_ptr_,
+				false /* releaseable_sets */);
+		init_chunk_dsgs(&chunk);
+	}
+
+	printf("dsg5\n");
+
+	axis_dsg_ptr_ = Anvil::DescriptorSetGroup::create(device_ptr_, false, 1);
+	axis_dsg_ptr_->add_binding(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
+		VK_SHADER_STAGE_VERTEX_BIT);
+
+	axis_dsg_ptr_->set_binding_item(
+		0, 0, Anvil::DescriptorSet::UniformBufferBindingElement(
+			viewMatrixUniformPointer, 0,
+			mat5UniformSizePerSwapchain));
+}
+
+// Bind the buffers of a chunk, and those shared by all chunks, to its
+// descriptor sets.
+void App::init_chunk_dsgs(SceneChunk* chunk) {
+	const VkDeviceSize chunk_meshes = CHUNK_MESHES;
+
 	// Bind to the compute shader a uniform layout for storing the current time.
-	compute_dsg_ptr_->set_binding_item(
+	chunk->compute_dsg->set_binding_item(
 		0,  // Set.
 		0,  // Binding.
 		Anvil::DescriptorSet::UniformBufferBindingElement(
 			viewProjUniformPointer,
 			0,  // Offset.
 			mat5UniformSizePerSwapchain));
+	chunk->compute_dsg->set_binding_item(
+		0,  // Set.
+		1,  // Binding.
+		Anvil::DescriptorSet::DynamicUniformBufferBindingElement(
+			drawArgumentsBufferPointer_,
+			0,  // Offset, dynamic per swapchain image and chunk.
+			sizeof(DrawArguments)));
 
-	printf("dsg2\n");
 	// NEW: cube
 	// Bind to the compute shader a buffer for recording input cube vertices.
-	compute_dsg_ptr_->set_binding_item(
+	chunk->compute_dsg->set_binding_item(
 		1,  // Set.
 		0,  // Binding.
 		Anvil::DescriptorSet::StorageBufferBindingElement(
-			inputCubeBufferPointer_,
+			chunk->input_buffer,
 			0,  // Offset.
-			sizeof(float) * 4 * N_MESHES));
+			sizeof(glm::vec4) * chunk_meshes));
 
-	printf("dsg4\n");
 	// Bind to the compute shader a buffer for recording the output cube vertices.
-	compute_dsg_ptr_->set_binding_item(
+	chunk->compute_dsg->set_binding_item(
 		1,  // Set.
 		1,  // Binding.
 		Anvil::DescriptorSet::StorageBufferBindingElement(
-			outputCubeVerticesBufferPointer_,
+			chunk->output_buffer,
 			0,  // Offset.
-			sizeof(float) * 4 * N_MESHES * N_VERTICES));
-	printf("dsg5\n");
-
-	/* Set up the descriptor set layout for the renderer program.  */
-	dsg_ptr_ = Anvil::DescriptorSetGroup::create(device_ptr_,
-		false, /* releaseable_sets */
-		1 /* n_sets           */);
+			sizeof(glm::vec4) * chunk_meshes * N_VERTICES));
 
-	dsg_ptr_->add_binding(0,                                    /* n_set      */
-		0,                                    /* binding    */
-		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, /* n_elements */
-		VK_SHADER_STAGE_VERTEX_BIT);
-
-	dsg_ptr_->set_binding_item(
+	chunk->dsg->set_binding_item(
 		0, /* n_set         */
 		0, /* binding_index */
 		Anvil::DescriptorSet::StorageBufferBindingElement(
-			outputCubeVerticesBufferPointer_, 0, /* in_start_offset */
-			sizeof(float) * 4 * N_MESHES * N_VERTICES));
-
-	axis_dsg_ptr_ = Anvil::DescriptorSetGroup::create(device_ptr_, false, 1);
-	axis_dsg_ptr_->add_binding(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
-		VK_SHADER_STAGE_VERTEX_BIT);
-
-	axis_dsg_ptr_->set_binding_item(
-		0, 0, Anvil::DescriptorSet::UniformBufferBindingElement(
-			viewMatrixUniformPointer, 0,
-			mat5UniformSizePerSwapchain));
+			chunk->output_buffer, 0, /* in_start_offset */
+			sizeof(glm::vec4) * chunk_meshes * N_VERTICES));
+
+	if (pipeline_stats_.HasCounters()) {
+		chunk->compute_dsg->set_binding_item(
+			1,  // Set.
+			2,  // Binding.
+			Anvil::DescriptorSet::DynamicStorageBufferBindingElement(
+				pipeline_stats_.GetCounterBuffer(),
+				0,  // Offset, dynamic per swapchain image.
+				pipeline_stats_.GetCounterRangeSize()));
+		chunk->dsg->set_binding_item(
+			0, /* n_set         */
+			1, /* binding_index */
+			Anvil::DescriptorSet::DynamicStorageBufferBindingElement(
+				pipeline_stats_.GetCounterBuffer(), 0, /* in_start_offset */
+				pipeline_stats_.GetCounterRangeSize()));
+	}
 }
 
 /*
@@ -450,7 +970,7 @@ void App::init_framebuffers() {
  */
 void App::init_semaphores() {
 	// Iterate through all associated semaphores.
-	for (uint32_t n_semaphore = 0; n_semaphore < n_swapchain_images_;
+	for (uint32_t n_semaphore = 0; n_semaphore < options_.frames_in_flight;
 	++n_semaphore) {
 		// Retrieve pointers to the semaphore grabs.
 		std::shared_ptr<Anvil::Semaphore> new_signal_semaphore_ptr =
@@ -467,6 +987,13 @@ void App::init_semaphores() {
 		// Push new semaphore data.
 		frame_signal_semaphores_.push_back(new_signal_semaphore_ptr);
 		frame_wait_semaphores_.push_back(new_wait_semaphore_ptr);
+
+		// Signalled once the GPU has finished the frame. Created signalled, so
+		// the first frame using it does not wait.
+		frame_fences_.push_back(Anvil::Fence::create(device_ptr_, true));
+	}
+	for (uint32_t n_image = 0; n_image < N_SWAPCHAIN_IMAGES; ++n_image) {
+		images_in_flight_[n_image] = VK_NULL_HANDLE;
 	}
 }
 
@@ -566,11 +1093,17 @@ void App::init_shaders() {
 		geo, Anvil::SHADER_STAGE_GEOMETRY);
 
 	/* Set up GLSLShader instances */
-	printf("Attempting to transmit N_MESHES: %d\n", N_MESHES);
-	compute_shader_ptr->add_definition_value_pair("N_MESHES", N_MESHES);
-	vertex_shader_ptr->add_definition_value_pair("N_MESHES", N_MESHES);
+	printf("Attempting to transmit CHUNK_MESHES: %d\n", CHUNK_MESHES);
+	compute_shader_ptr->add_definition_value_pair("CHUNK_MESHES", CHUNK_MESHES);
+	vertex_shader_ptr->add_definition_value_pair("CHUNK_MESHES", CHUNK_MESHES);
+	compute_shader_ptr->add_definition_value_pair("FREE_SLOT",
+		BlockSlots::kFreeCoordinate);
 	compute_shader_ptr->add_definition_value_pair("N_VERTICES", N_VERTICES);
 	vertex_shader_ptr->add_definition_value_pair("N_VERTICES", N_VERTICES);
+	if (pipeline_stats_.HasCounters()) {
+		compute_shader_ptr->add_definition_value_pair("ENABLE_PIPELINE_COUNTERS", 1);
+		geo_shader_ptr->add_definition_value_pair("ENABLE_PIPELINE_COUNTERS", 1);
+	}
 
 	compute_shader_module_ptr = Anvil::ShaderModule::create_from_spirv_generator(
 		device_ptr_, compute_shader_ptr);
@@ -648,12 +1181,11 @@ void App::init_gfx_pipelines() {
 		device_locked_ptr->get_graphics_pipeline_manager());
 	bool result;
 
-	/* Create a renderpass instance */
-#ifdef ENABLE_OFFSCREEN_RENDERING
-	const VkImageLayout final_layout = VK_IMAGE_LAYOUT_GENERAL;
-#else
-	const VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
+	/* Create a renderpass instance. Offscreen swapchain images are read back
+	   in the general layout. */
+	const VkImageLayout final_layout = options_.headless
+		? VK_IMAGE_LAYOUT_GENERAL
+		: VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	Anvil::RenderPassAttachmentID render_pass_color_attachment_id = -1;
 	Anvil::RenderPassAttachmentID render_pass_depth_attachment_id = -1;
@@ -816,6 +1348,33 @@ void App::init_images() {
 	}
 }
 
+/*
+  PROFILER INITIALIZATION.
+  Create the timestamp queries, statistics queries and shader counters
+  recorded around each pass, if requested.
+ */
+void App::init_profiler() {
+	if (options_.gpu_profile) {
+		gpu_profiler_.Init(device_ptr_, N_SWAPCHAIN_IMAGES);
+		if (!options_.gpu_profile_log.empty()) {
+			gpu_profiler_.OpenLog(options_.gpu_profile_log);
+		}
+	}
+	if (options_.pipeline_stats || options_.shader_counters) {
+		pipeline_stats_.Init(device_ptr_, N_SWAPCHAIN_IMAGES,
+			options_.pipeline_stats, options_.shader_counters);
+		if (pipeline_stats_.HasCounters()) {
+			add_buffer(pipeline_stats_.GetCounterBuffer(),
+				Anvil::MEMORY_FEATURE_FLAG_MAPPABLE);
+			bake_buffers();
+		}
+	}
+	frame_recorder_.SetReporting(options_.frame_stats || DEBUG_FRAME_TIME);
+	if (!options_.frame_stats_log.empty()) {
+		frame_recorder_.OpenLog(options_.frame_stats_log);
+	}
+}
+
 // Actually intialize the command buffers.
 void App::init_command_buffers() {
 	// Boilerplate to prepare the graphics pipeline.
@@ -851,6 +1410,19 @@ void App::init_command_buffers() {
 		// Start recording commands.
 		draw_cmd_buffer_ptr->start_recording(false,  // One-time submit.
 			true);  // Simultaneous use allowed.
+		gpu_profiler_.RecordReset(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image);
+		pipeline_stats_.RecordReset(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image);
+
+		// Each swapchain image writes its own range of the shader counters.
+		const uint32_t counter_offset =
+			pipeline_stats_.GetCounterOffset(n_current_swapchain_image);
+		const uint32_t n_counter_offsets = pipeline_stats_.HasCounters() ? 1 : 0;
+
+		// ...and reads its own draw arguments, one set per chunk.
+		const VkDeviceSize draw_arguments_offset =
+			n_current_swapchain_image * drawArgumentsSizePerSwapchain_;
 
 // Switch the swap-chain image layout to renderable.
 		{
@@ -910,6 +1482,26 @@ void App::init_command_buffers() {
 			0,                        // in_image_memory_barrier_count
 			nullptr);                 // in_image_memory_barriers_ptr
 
+		Anvil::BufferBarrier draw_arguments_buffer_barrier = Anvil::BufferBarrier(
+			VK_ACCESS_HOST_WRITE_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			drawArgumentsBufferPointer_,
+			draw_arguments_offset,
+			drawArgumentsSizePerSwapchain_);
+
+		draw_cmd_buffer_ptr->record_pipeline_barrier(
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FALSE,
+			0,                        // in_memory_barrier_count
+			nullptr,                  // in_memory_barriers_ptr
+			1,                        // in_buffer_memory_barrier_count
+			&draw_arguments_buffer_barrier,  // in_buffer_memory_barriers_ptr
+			0,                        // in_image_memory_barrier_count
+			nullptr);                 // in_image_memory_barriers_ptr
+
 		// Let's generate some sine offset data using our compute shader.
 		draw_cmd_buffer_ptr->record_bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE,
 			compute_pipeline_id_);
@@ -920,24 +1512,37 @@ void App::init_command_buffers() {
 				"Sine offset data computation", region_color);
 		}
 
-		printf("c0\n");
-		std::shared_ptr<Anvil::DescriptorSet> producer_dses[] = {
-			compute_dsg_ptr_->get_descriptor_set(0),
-			compute_dsg_ptr_->get_descriptor_set(1) };
-
-		printf("c0.1\n");
-		static const uint32_t n_producer_dses =
-			sizeof(producer_dses) / sizeof(producer_dses[0]);
-
-		printf("c1 n_producer_dses: %d\n", n_producer_dses);
-		draw_cmd_buffer_ptr->record_bind_descriptor_sets(
-			VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayoutPointer,
-			0, /* firstSet */
-			n_producer_dses, producer_dses, 0, nullptr);
-
-		draw_cmd_buffer_ptr->record_dispatch(1 + (N_MESHES / 512),  /* x */
-			1,  /* y */
-			1); /* z */
+		pipeline_stats_.RecordBegin(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image);
+		gpu_profiler_.RecordBegin(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_COMPUTE);
+		for (size_t n_chunk = 0; n_chunk < scene_chunks_.size(); ++n_chunk) {
+			std::shared_ptr<Anvil::DescriptorSet> producer_dses[] = {
+				scene_chunks_[n_chunk].compute_dsg->get_descriptor_set(0),
+				scene_chunks_[n_chunk].compute_dsg->get_descriptor_set(1) };
+			static const uint32_t n_producer_dses =
+				sizeof(producer_dses) / sizeof(producer_dses[0]);
+
+			// The draw arguments come first in the compute shader's dynamic
+			// offsets.
+			const VkDeviceSize chunk_arguments_offset =
+				draw_arguments_offset + n_chunk * drawArgumentsStride_;
+			const uint32_t compute_offsets[] = {
+				static_cast<uint32_t>(chunk_arguments_offset), counter_offset };
+			draw_cmd_buffer_ptr->record_bind_descriptor_sets(
+				VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayoutPointer,
+				0, /* firstSet */
+				n_producer_dses, producer_dses,
+				1 + n_counter_offsets, compute_offsets);
+
+			// The number of blocks grows while a scene loads, so the dispatch
+			// and draw sizes are read from the draw arguments of the frame.
+			draw_cmd_buffer_ptr->record_dispatch_indirect(
+				drawArgumentsBufferPointer_,
+				chunk_arguments_offset + offsetof(DrawArguments, dispatch));
+		}
+		gpu_profiler_.RecordEnd(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_COMPUTE);
 
 		if (is_debug_marker_ext_present) {
 			draw_cmd_buffer_ptr->record_debug_marker_end_EXT();
@@ -962,16 +1567,13 @@ void App::init_command_buffers() {
 		// NOTE: The render-pass switches the swap-chain image back to the
 		// presentable layout
 		//      after the draw call finishes.
+		gpu_profiler_.RecordBegin(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_MAIN);
 		draw_cmd_buffer_ptr->record_begin_render_pass(
 			2,  // n_clear_values
 			clear_values, fbos_[n_current_swapchain_image], render_area,
 			renderpass_ptr_, VK_SUBPASS_CONTENTS_INLINE);
 		{
-			std::shared_ptr<Anvil::DescriptorSet> renderer_dses[] = {
-				dsg_ptr_->get_descriptor_set(0) };
-			const uint32_t n_renderer_dses =
-				sizeof(renderer_dses) / sizeof(renderer_dses[0]);
-
 			std::shared_ptr<Anvil::PipelineLayout> renderer_pipeline_layout_ptr;
 
 			renderer_pipeline_layout_ptr =
@@ -984,7 +1586,7 @@ void App::init_command_buffers() {
 			static const VkDeviceSize offsets = 0;
 			draw_cmd_buffer_ptr->record_bind_vertex_buffers(0,  // startBinding
 				1,  // bindingCount
-				&inputCubeBufferPointer_,
+				&scene_chunks_[0].input_buffer,
 				&offsets);
 
 			// Set line width.
@@ -992,19 +1594,36 @@ void App::init_command_buffers() {
 			draw_cmd_buffer_ptr->record_set_line_width(lineWidth);
 			printf("c4\n");
 
-			draw_cmd_buffer_ptr->record_bind_descriptor_sets(
-				VK_PIPELINE_BIND_POINT_GRAPHICS, renderer_pipeline_layout_ptr,
-				0, /* firstSet */
-				n_renderer_dses, renderer_dses, 0, nullptr);
-
-			draw_cmd_buffer_ptr->record_draw((N_MESHES * N_VERTICES), 1, /* instanceCount */
-				0,     /* firstVertex   */
-				0);    /* firstInstance */
+			for (size_t n_chunk = 0; n_chunk < scene_chunks_.size(); ++n_chunk) {
+				std::shared_ptr<Anvil::DescriptorSet> renderer_dses[] = {
+					scene_chunks_[n_chunk].dsg->get_descriptor_set(0) };
+				const uint32_t n_renderer_dses =
+					sizeof(renderer_dses) / sizeof(renderer_dses[0]);
+
+				draw_cmd_buffer_ptr->record_bind_descriptor_sets(
+					VK_PIPELINE_BIND_POINT_GRAPHICS, renderer_pipeline_layout_ptr,
+					0, /* firstSet */
+					n_renderer_dses, renderer_dses,
+					n_counter_offsets, &counter_offset);
+
+				draw_cmd_buffer_ptr->record_draw_indirect(
+					drawArgumentsBufferPointer_,
+					draw_arguments_offset + n_chunk * drawArgumentsStride_ +
+					offsetof(DrawArguments, draw),
+					1,  /* count  */
+					sizeof(VkDrawIndirectCommand));  /* stride */
+			}
 
 		}
 		draw_cmd_buffer_ptr->record_end_render_pass();
+		gpu_profiler_.RecordEnd(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_MAIN);
+		pipeline_stats_.RecordEnd(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image);
 
 		printf("c5\n");
+		gpu_profiler_.RecordBegin(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_AXIS);
 		draw_cmd_buffer_ptr->record_begin_render_pass(
 			0,
 			nullptr, fbos_[n_current_swapchain_image], render_area,
@@ -1026,7 +1645,7 @@ void App::init_command_buffers() {
 			static const VkDeviceSize offsets = 0;
 			draw_cmd_buffer_ptr->record_bind_vertex_buffers(0,  // startBinding
 				1,  // bindingCount
-				&inputCubeBufferPointer_,
+				&scene_chunks_[0].input_buffer,
 				&offsets);
 			float lineWidth = 2;
 			draw_cmd_buffer_ptr->record_set_line_width(lineWidth);
@@ -1040,12 +1659,41 @@ void App::init_command_buffers() {
 #endif
 		}
 		draw_cmd_buffer_ptr->record_end_render_pass();
+		gpu_profiler_.RecordEnd(draw_cmd_buffer_ptr.get(),
+			n_current_swapchain_image, GpuProfiler::PASS_AXIS);
 
 		// Close the recording process.
 		draw_cmd_buffer_ptr->stop_recording();
 		command_buffers_[n_current_swapchain_image] = draw_cmd_buffer_ptr;
 		printf("c6\n");
 	}
+	init_frame_handles();
+}
+
+void App::init_frame_handles() {
+	std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr(device_ptr_);
+	const Anvil::ExtensionKHRSwapchainEntrypoints& swapchain_entrypoints =
+		device_locked_ptr->get_extension_khr_swapchain_entrypoints();
+
+	frame_handles_.device = device_locked_ptr->get_device_vk();
+	frame_handles_.universal_queue =
+		device_locked_ptr->get_universal_queue(0)->get_queue();
+	frame_handles_.present_queue = present_queue_ptr_->get_queue();
+	frame_handles_.swapchain = swapchain_ptr_->get_swapchain_vk();
+	frame_handles_.acquire_next_image =
+		swapchain_entrypoints.vkAcquireNextImageKHR;
+	frame_handles_.queue_present = swapchain_entrypoints.vkQueuePresentKHR;
+	for (uint32_t n_frame = 0; n_frame < options_.frames_in_flight; ++n_frame) {
+		frame_handles_.signal_semaphores[n_frame] =
+			frame_signal_semaphores_[n_frame]->get_semaphore();
+		frame_handles_.wait_semaphores[n_frame] =
+			frame_wait_semaphores_[n_frame]->get_semaphore();
+		frame_handles_.frame_fences[n_frame] = frame_fences_[n_frame]->get_fence();
+	}
+	for (uint32_t n_image = 0; n_image < N_SWAPCHAIN_IMAGES; ++n_image) {
+		frame_handles_.command_buffers[n_image] =
+			command_buffers_[n_image]->get_command_buffer();
+	}
 }
 
 void App::init_camera() {
@@ -1053,74 +1701,44 @@ void App::init_camera() {
 	camera_.UpdateView();
 	camera_.UpdateProj();
 	camera_.GetViewProj().Print();
-	camera_.SetTerrain(MESH_CENTERS);
-	Callback::GetInstance()->init(this, &camera_, GetGLFWWindow());
+	std::vector<glm::vec4> terrain;
+	terrain.reserve(block_slots_.GetBlockCount());
+	for (const glm::vec4& center : block_slots_.GetCenters()) {
+		if (center.x != BlockSlots::kFreeCoordinate) {
+			terrain.push_back(center);
+		}
+	}
+	camera_.SetTerrain(terrain);
+	if (!options_.camera_path.empty() &&
+		camera_path_.Load(options_.camera_path)) {
+		printf("Replaying camera path \"%s\" for %u frames.\n",
+			options_.camera_path.c_str(), camera_path_.GetFrameCount());
+	}
+	if (!options_.record_path.empty()) {
+		camera_recording_.StartRecording();
+		camera_.SetRecorder(&camera_recording_);
+	}
+	if (options_.headless) {
+		return;
+	}
+	Callback::GetInstance()->init(this, GetGLFWWindow());
 	glfwSetKeyCallback(GetGLFWWindow(), Callback::on_keypress_event);
+	if (IsReplaying()) {
+		// The path owns the camera; keys are still needed to quit.
+		return;
+	}
 	glfwSetMouseButtonCallback(GetGLFWWindow(), Callback::on_mouse_button_event);
 	glfwSetCursorPosCallback(GetGLFWWindow(), Callback::on_mouse_move_event);
 	glfwSetScrollCallback(GetGLFWWindow(), Callback::on_mouse_scroll_event);
 	glfwSetInputMode(GetGLFWWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 }
 
-void App::handle_keys() {
-	auto keys = Callback::GetInstance()->get_keys();
-	for (int key : *keys) {
-		switch (key) {
-		case 'w': case 'W':
-			camera_.MoveForward(0.1f);
-			break;
-		case 's': case 'S':
-			camera_.MoveBackward(0.1f);
-			break;
-		case 'a': case 'A':
-			camera_.MoveLeft(0.1f);
-			break;
-		case 'd': case 'D':
-			camera_.MoveRight(0.1f);
-			break;
-		case 'q': case 'Q':
-			camera_.MoveAna(0.1f);
-			break;
-		case 'e': case 'E':
-			camera_.MoveKata(0.1f);
-			break;
-		case 'r': case 'R':
-			camera_.MoveUp(0.1f);
-			break;
-		case 'f': case 'F':
-			camera_.MoveDown(0.1f);
-			break;
-		case '1':
-			camera_.RollLeft(0.015f);
-			break;
-		case '3':
-			camera_.RollRight(0.015f);
-			break;
-		}
+void App::OnCameraInput(Simulation::InputEvent event) {
+	if (!simulation_.IsRunning()) {
+		return;
 	}
-
-	// KEEP for debugging
-	// std::cout << "\n";
-	// mat5 view = camera_.GetViewProj();
-	// (view * vec5(1, 1, 1, 1, 1)).Print();
-	//glm::mat4 view4 =
-	//   glm::lookAt(glm::vec3(-5, 0, 0), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-	// glm::vec4 f = view4 * glm::vec4(1, 2, 3, 4);
-	// mat5 view5 = camera_.getView();
-	// (view5 * vec5(1, 1, 1, 1, 1)).Print();
-	// view5.Print();
-	// glm::mat4 proj4 = glm::perspective(30.0, 0.75, 1.0, 20.0);
-	// mat5 proj5 = camera_.getProj();
-	// glm::mat4 tran = glm::translate(glm::mat4(1), glm::vec3(1, 2, 3));
-	// glm::mat4 t2 = view4 * tran;
-	// glm::mat4 t3 = glm::translate(view4, glm::vec3(1, 2, 3));
-	// std::cout << "view:\n";
-	// view5.Print();
-	// std::cout << "proj:\n";
-	// proj5.Print();
-	// std::cout << "viewproj:\n";
-	// camera_.GetViewProj().Print();
-	// std::cout << "\n";
+	event.ordinal = input_latency_.OnInput();
+	simulation_.PushInput(event);
 }
 
 // Toggles between drawing a solid envelope or a wireframe shape.
@@ -1131,11 +1749,16 @@ void App::ToggleRenderMode() {
 	} else {
 		N_VERTICES = 144;
 	}
+	recreate_rendering();
+}
 
+// Rebuilds everything that depends on N_VERTICES or MAX_MESHES.
+void App::recreate_rendering() {
 	vkDeviceWaitIdle(device_ptr_.lock()->get_device_vk());
 
 	frame_signal_semaphores_.clear();
 	frame_wait_semaphores_.clear();
+	frame_fences_.clear();
 
 	for (uint32_t n_cmd_buffer = 0;
 	n_cmd_buffer < sizeof(command_buffers_) / sizeof(command_buffers_[0]);
@@ -1161,6 +1784,7 @@ void App::ToggleRenderMode() {
 		fbos_[n_fbo] = nullptr;
 	}
 
+	scene_chunks_.clear();
 	dsg_ptr_.reset();
 	fs_ptr_.reset();
 	renderpass_ptr_.reset();
@@ -1207,98 +1831,210 @@ void App::ToggleRenderMode() {
   Handle the task of drawing a frame for the app.
  */
 void App::draw_frame(void* app_raw_ptr) {
+	// Everything below works on the raw Vulkan handles of frame_handles_ and
+	// on persistently mapped buffers, so that a frame makes no heap
+	// allocations. Only the headless dummy swapchain, which has no Vulkan
+	// swapchain behind it, goes through Anvil.
 	App* app_ptr = static_cast<App*>(app_raw_ptr);
-	std::shared_ptr<Anvil::Semaphore> curr_frame_signal_semaphore_ptr;
-	std::shared_ptr<Anvil::Semaphore> curr_frame_wait_semaphore_ptr;
-	std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr =
-		app_ptr->device_ptr_.lock();
+	const FrameHandles& handles = app_ptr->frame_handles_;
 	static uint32_t n_frames_rendered = 0;
 	uint32_t n_swapchain_image;
-	std::shared_ptr<Anvil::Semaphore> present_wait_semaphore_ptr;
 	const VkPipelineStageFlags wait_stage_mask =
 		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
-	// Determine the signal + wait semaphores to use for drawing this frame.
-	app_ptr->n_last_semaphore_used_ =
-		(app_ptr->n_last_semaphore_used_ + 1) % app_ptr->n_swapchain_images_;
-
-	curr_frame_signal_semaphore_ptr =
-		app_ptr->frame_signal_semaphores_[app_ptr->n_last_semaphore_used_];
-	curr_frame_wait_semaphore_ptr =
-		app_ptr->frame_wait_semaphores_[app_ptr->n_last_semaphore_used_];
+	// Determine the signal + wait semaphores and the fence of this frame.
+	app_ptr->n_last_semaphore_used_ = (app_ptr->n_last_semaphore_used_ + 1) %
+		app_ptr->options_.frames_in_flight;
+	const uint32_t n_semaphore = app_ptr->n_last_semaphore_used_;
+	const VkFence frame_fence = handles.frame_fences[n_semaphore];
+
+	// Wait until the GPU has finished the frame that last used these
+	// semaphores, which keeps the CPU at most frames_in_flight frames ahead,
+	// then determine the swapchain image.
+	auto acquire_start = std::chrono::steady_clock::now();
+	vkWaitForFences(handles.device, 1, &frame_fence, VK_TRUE, UINT64_MAX);
+	if (app_ptr->options_.headless) {
+		n_swapchain_image = app_ptr->swapchain_ptr_->acquire_image(
+			app_ptr->frame_wait_semaphores_[n_semaphore], true);
+	} else {
+		handles.acquire_next_image(handles.device, handles.swapchain,
+			UINT64_MAX, handles.wait_semaphores[n_semaphore], VK_NULL_HANDLE,
+			&n_swapchain_image);
+	}
 
-	present_wait_semaphore_ptr = curr_frame_signal_semaphore_ptr;
+	// The image's uniforms and draw arguments are rewritten below, so an
+	// earlier frame that still renders to it has to finish first.
+	VkFence& image_fence = app_ptr->images_in_flight_[n_swapchain_image];
+	if (image_fence != VK_NULL_HANDLE && image_fence != frame_fence) {
+		vkWaitForFences(handles.device, 1, &image_fence, VK_TRUE, UINT64_MAX);
+	}
+	image_fence = frame_fence;
+	vkResetFences(handles.device, 1, &frame_fence);
+	auto acquire_end = std::chrono::steady_clock::now();
+
+	// Pick up the GPU timings and statistics of the last frame that used this
+	// image.
+	app_ptr->gpu_profiler_.Collect(n_swapchain_image);
+	app_ptr->pipeline_stats_.Collect(n_swapchain_image);
+
+	// Advance a scripted camera by exactly one step per frame.
+	if (app_ptr->IsReplaying()) {
+		app_ptr->camera_path_.Apply(n_frames_rendered, &app_ptr->camera_);
+	}
 
-	// Determine the semaphore which the swapchain image.
-	n_swapchain_image = app_ptr->swapchain_ptr_->acquire_image(
-		curr_frame_wait_semaphore_ptr, true);
+	// While the simulation thread owns the camera, show its view blended
+	// between the last two ticks. The projection never changes after
+	// init_camera(), so it is safe to read here. The view is relative to the
+	// eye, and each chunk is placed relative to the eye in double precision,
+	// so blocks near the camera keep their precision anywhere in the world.
+	mat5 view;
+	glm::dvec4 eye;
+	uint64_t n_inputs_applied = 0;
+	if (app_ptr->simulation_.IsRunning()) {
+		view = app_ptr->simulation_.GetView(std::chrono::steady_clock::now(),
+			&eye, &n_inputs_applied);
+	} else {
+		view = app_ptr->camera_.GetRelativeView();
+		eye = app_ptr->camera_.GetPrecisePosition();
+	}
 
 	// Update View Proj matrix,
-	mat5 viewProj = app_ptr->camera_.GetViewProj();
-	app_ptr->viewProjUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image,  // Offset.
-		sizeof(glm::mat4), &viewProj.get_main_mat());
-	app_ptr->viewProjUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4),  // Offset.
-		sizeof(glm::vec4),
-		&viewProj.get_column());
-	app_ptr->viewProjUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4) + sizeof(glm::vec4),  // Offset.
-		sizeof(glm::vec4),
-		&viewProj.get_row());
-	app_ptr->viewProjUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4) + 2 * sizeof(glm::vec4),  // Offset.
-		sizeof(float),
-		&viewProj.get_ww());
+	write_mat5(app_ptr->viewProjMapped_ +
+		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image,
+		app_ptr->camera_.getProj() * view);
 
 	// Update View matrix,
-	mat5 view = app_ptr->camera_.getView();
-	app_ptr->viewMatrixUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image,  // Offset.
-		sizeof(glm::mat4), &view.get_main_mat());
-	app_ptr->viewMatrixUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4),  // Offset.
-		sizeof(glm::vec4),
-		&view.get_column());
-	app_ptr->viewMatrixUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4) + sizeof(glm::vec4),  // Offset.
-		sizeof(glm::vec4),
-		&view.get_row());
-	app_ptr->viewMatrixUniformPointer->write(
-		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image +
-		sizeof(glm::mat4) + 2 * sizeof(glm::vec4),  // Offset.
-		sizeof(float),
-		&view.get_ww());
+	write_mat5(app_ptr->viewMatrixMapped_ +
+		app_ptr->mat5UniformSizePerSwapchain * n_swapchain_image, view);
+
+	// Upload the slots of the blocks edited and loaded since the last frame,
+	// and size the dispatch and draw of this frame to match. The slots are
+	// copied by this frame's submission rather than a blocking one.
+	const BlockSlots& block_slots = app_ptr->block_slots_;
+	app_ptr->staging_uploader_.BeginFrame(n_swapchain_image);
+	app_ptr->upload_block_slots();
+	const VkCommandBuffer upload_command_buffer =
+		app_ptr->staging_uploader_.EndFrame();
+	for (size_t n_chunk = 0; n_chunk < app_ptr->scene_chunks_.size();
+		++n_chunk) {
+		const bool has_blocks = n_chunk < block_slots.GetChunkCount();
+		const uint32_t n_meshes = has_blocks
+			? static_cast<uint32_t>(block_slots.GetChunkSlotCount(n_chunk)) : 0;
+		DrawArguments draw_arguments;
+		draw_arguments.dispatch.x = (n_meshes + 511) / 512;
+		draw_arguments.dispatch.y = 1;
+		draw_arguments.dispatch.z = 1;
+		draw_arguments.n_meshes = n_meshes;
+		draw_arguments.draw.vertexCount = n_meshes * N_VERTICES;
+		draw_arguments.draw.instanceCount = 1;
+		draw_arguments.draw.firstVertex = 0;
+		draw_arguments.draw.firstInstance = 0;
+		draw_arguments.chunk_offset = has_blocks ? glm::vec4(
+			glm::dvec4(block_slots.GetChunkOrigin(n_chunk)) - eye) : glm::vec4(0.0f);
+		memcpy(&app_ptr->draw_arguments_[n_chunk * app_ptr->drawArgumentsStride_],
+			&draw_arguments, sizeof(draw_arguments));
+	}
+	memcpy(app_ptr->drawArgumentsMapped_ +
+		app_ptr->drawArgumentsSizePerSwapchain_ * n_swapchain_image,
+		app_ptr->draw_arguments_.data(), app_ptr->drawArgumentsSizePerSwapchain_);
 
 	/* Submit jobs to relevant queues and make sure they are correctly
 	 * synchronized */
-	device_locked_ptr->get_universal_queue(0)
-		->submit_command_buffer_with_signal_wait_semaphores(
-			app_ptr->command_buffers_[n_swapchain_image],
-			1,                                   /* n_semaphores_to_signal */
-			&curr_frame_signal_semaphore_ptr, 1, /* n_semaphores_to_wait_on */
-			&curr_frame_wait_semaphore_ptr, &wait_stage_mask,
-			false, /* should_block */
-			nullptr);
-
-	app_ptr->present_queue_ptr_->present(
-		app_ptr->swapchain_ptr_, n_swapchain_image, 1, /* n_wait_semaphores */
-		&present_wait_semaphore_ptr);
+	auto submit_start = std::chrono::steady_clock::now();
+	VkSubmitInfo submit_info;
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = nullptr;
+	submit_info.waitSemaphoreCount = 1;
+	submit_info.pWaitSemaphores = &handles.wait_semaphores[n_semaphore];
+	submit_info.pWaitDstStageMask = &wait_stage_mask;
+	VkCommandBuffer command_buffers[2];
+	uint32_t n_command_buffers = 0;
+	if (upload_command_buffer != VK_NULL_HANDLE) {
+		command_buffers[n_command_buffers++] = upload_command_buffer;
+	}
+	command_buffers[n_command_buffers++] =
+		handles.command_buffers[n_swapchain_image];
+	submit_info.commandBufferCount = n_command_buffers;
+	submit_info.pCommandBuffers = command_buffers;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &handles.signal_semaphores[n_semaphore];
+	vkQueueSubmit(handles.universal_queue, 1, &submit_info, frame_fence);
+
+	// A submission without batches signals its fence once all earlier work on
+	// the queue has finished, which gives the statistics their own fence.
+	const VkFence stats_fence =
+		app_ptr->pipeline_stats_.GetSubmitFence(n_swapchain_image);
+	if (stats_fence != VK_NULL_HANDLE) {
+		vkQueueSubmit(handles.universal_queue, 0, nullptr, stats_fence);
+	}
+	app_ptr->gpu_profiler_.OnSubmit(n_swapchain_image);
+	auto submit_end = std::chrono::steady_clock::now();
+
+	if (app_ptr->options_.headless) {
+		app_ptr->present_queue_ptr_->present(
+			app_ptr->swapchain_ptr_, n_swapchain_image, 1, /* n_wait_semaphores */
+			&app_ptr->frame_signal_semaphores_[n_semaphore]);
+	} else {
+		VkPresentInfoKHR present_info;
+		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.pNext = nullptr;
+		present_info.waitSemaphoreCount = 1;
+		present_info.pWaitSemaphores = &handles.signal_semaphores[n_semaphore];
+		present_info.swapchainCount = 1;
+		present_info.pSwapchains = &handles.swapchain;
+		present_info.pImageIndices = &n_swapchain_image;
+		present_info.pResults = nullptr;
+		handles.queue_present(handles.present_queue, &present_info);
+	}
+	auto present_end = std::chrono::steady_clock::now();
+	app_ptr->input_latency_.OnPresent(n_inputs_applied);
+	StartupTimer::GetInstance()->MarkFirstPresent();
+
+	typedef std::chrono::duration<double, std::milli> milliseconds;
+	app_ptr->frame_recorder_.Record(FrameRecorder::METRIC_ACQUIRE,
+		milliseconds(acquire_end - acquire_start).count());
+	app_ptr->frame_recorder_.Record(FrameRecorder::METRIC_SUBMIT,
+		milliseconds(submit_end - submit_start).count());
+	app_ptr->frame_recorder_.Record(FrameRecorder::METRIC_PRESENT,
+		milliseconds(present_end - submit_end).count());
 
 	++n_frames_rendered;
+	if (!app_ptr->simulation_.IsRunning()) {
+		app_ptr->camera_recording_.SetFrame(n_frames_rendered);
+	}
+	if (n_frames_rendered % PROFILE_REPORT_INTERVAL == 0) {
+		app_ptr->gpu_profiler_.Report();
+		app_ptr->pipeline_stats_.Report(
+			app_ptr->frame_recorder_.RecentAverage(FrameRecorder::METRIC_FRAME));
+		if (app_ptr->input_latency_.IsEnabled()) {
+			app_ptr->input_latency_.Report(false);
+		}
+	}
 
-#if defined(ENABLE_OFFSCREEN_RENDERING)
 	{
-		if (n_frames_rendered >= N_FRAMES_TO_RENDER) {
-			window_ptr_->close();
+		auto cur_time = std::chrono::steady_clock::now();
+		milliseconds dif = cur_time - app_ptr->prev_time;
+		app_ptr->frame_recorder_.Record(FrameRecorder::METRIC_FRAME, dif.count());
+		if (AllocationCounter::IsEnabled()) {
+			const uint64_t n_allocations = AllocationCounter::GetThreadCount();
+			app_ptr->frame_recorder_.RecordAllocations(
+				n_allocations - app_ptr->n_frame_allocations_);
+			app_ptr->n_frame_allocations_ = n_allocations;
+		}
+		app_ptr->frame_recorder_.EndFrame();
+		app_ptr->prev_time = cur_time;
+	}
+
+	const uint32_t n_frames_to_render = app_ptr->IsReplaying()
+		? app_ptr->camera_path_.GetFrameCount()
+		: app_ptr->options_.headless_frames;
+	if (n_frames_rendered >= n_frames_to_render) {
+		if (app_ptr->options_.headless) {
+			app_ptr->window_ptr_->close();
+		} else if (app_ptr->IsReplaying()) {
+			glfwSetWindowShouldClose(GetGLFWWindow(), true);
 		}
 	}
-#endif
 
 	// Read all data points back.
 	if (DEBUG_REREAD) {
@@ -1306,29 +2042,29 @@ void App::draw_frame(void* app_raw_ptr) {
 			if (i != 32 && i != 33) continue;
 			glm::vec4 input, output;
 			/*
-			app_ptr->inputCubeBufferPointer_->read(
-				app_ptr->inputCubeElementOffsets_[i] + 0 * sizeof(float),
+			app_ptr->scene_chunks_[0].input_buffer->read(
+				i * sizeof(glm::vec4) + 0 * sizeof(float),
 				sizeof(float), &input.x);
-			app_ptr->inputCubeBufferPointer_->read(
-				app_ptr->inputCubeElementOffsets_[i] + 1 * sizeof(float),
+			app_ptr->scene_chunks_[0].input_buffer->read(
+				i * sizeof(glm::vec4) + 1 * sizeof(float),
 				sizeof(float), &input.y);
-			app_ptr->inputCubeBufferPointer_->read(
-				app_ptr->inputCubeElementOffsets_[i] + 2 * sizeof(float),
+			app_ptr->scene_chunks_[0].input_buffer->read(
+				i * sizeof(glm::vec4) + 2 * sizeof(float),
 				sizeof(float), &input.z);
-			app_ptr->inputCubeBufferPointer_->read(
-				app_ptr->inputCubeElementOffsets_[i] + 3 * sizeof(float),
+			app_ptr->scene_chunks_[0].input_buffer->read(
+				i * sizeof(glm::vec4) + 3 * sizeof(float),
 				sizeof(float), &input.w);*/
-			app_ptr->outputCubeVerticesBufferPointer_->read(
-				app_ptr->outputCubeVerticesBufferSizes_[i] + 0 * sizeof(float),
+			app_ptr->scene_chunks_[0].output_buffer->read(
+				i * sizeof(glm::vec4) + 0 * sizeof(float),
 				sizeof(float), &output.x);
-			app_ptr->outputCubeVerticesBufferPointer_->read(
-				app_ptr->outputCubeVerticesBufferSizes_[i] + 1 * sizeof(float),
+			app_ptr->scene_chunks_[0].output_buffer->read(
+				i * sizeof(glm::vec4) + 1 * sizeof(float),
 				sizeof(float), &output.y);
-			app_ptr->outputCubeVerticesBufferPointer_->read(
-				app_ptr->outputCubeVerticesBufferSizes_[i] + 2 * sizeof(float),
+			app_ptr->scene_chunks_[0].output_buffer->read(
+				i * sizeof(glm::vec4) + 2 * sizeof(float),
 				sizeof(float), &output.z);
-			app_ptr->outputCubeVerticesBufferPointer_->read(
-				app_ptr->outputCubeVerticesBufferSizes_[i] + 3 * sizeof(float),
+			app_ptr->scene_chunks_[0].output_buffer->read(
+				i * sizeof(glm::vec4) + 3 * sizeof(float),
 				sizeof(float), &output.w);
 			if (output.x < 1 && output.x > -1 &&
 				output.y < 1 && output.y > -1 &&
@@ -1339,9 +2075,8 @@ void App::draw_frame(void* app_raw_ptr) {
 				std::cout << "FAR";
 			}
 
-			//std::cout << "i offset: " << app_ptr->inputCubeElementOffsets_[i] << "\n";
-			std::cout << "o offset: " << i << " "
-				<< app_ptr->outputCubeVerticesBufferSizes_[i] << "\n";
+			//std::cout << "i offset: " << i * sizeof(glm::vec4) << "\n";
+			std::cout << "o offset: " << i * sizeof(glm::vec4) << "\n";
 			//std::cout << "i (" << input.x << ", " << input.y << ", " << input.z
 			//          << ", " << input.w << ")\n";
 			std::cout << "o (" << output.x << ", " << output.y << ", " << output.z
@@ -1350,19 +2085,55 @@ void App::draw_frame(void* app_raw_ptr) {
 	}
 }
 
-void App::run() { //window_ptr_->run(); 
-	while (!ShouldQuit()) {
-		glfwPollEvents();
-		draw_frame(this);
-		if (DEBUG_FRAME_TIME && !DEBUG_BAKE_TIME) {
-			auto cur_time = std::chrono::steady_clock::now();
-			std::chrono::duration<double, std::milli> dif = cur_time - prev_time;
-			std::cout << dif.count() << "\n";
-			prev_time = cur_time;
+void App::run() {
+	prev_time = std::chrono::steady_clock::now();
+	if (options_.headless) {
+		// The dummy window drives draw_frame() until it is closed.
+		window_ptr_->run();
+		vkDeviceWaitIdle(device_ptr_.lock()->get_device_vk());
+	} else {
+		// Interactive sessions move the camera on the simulation thread; a
+		// replayed path steps it once per frame in draw_frame().
+		if (!IsReplaying()) {
+			simulation_.Start(&camera_,
+				camera_recording_.IsRecording() ? &camera_recording_ : nullptr);
+		}
+		while (!ShouldQuit()) {
+			frame_limiter_.Wait();
+			glfwPollEvents();
+			apply_scene_patches();
+			append_scene_blocks(SCENE_BLOCKS_PER_FRAME, false);
+			reserve_block_slots();
+			draw_frame(this);
 		}
-		handle_keys();
+		simulation_.Stop();
+	}
+	gpu_profiler_.Report();
+	pipeline_stats_.Report(
+		frame_recorder_.RecentAverage(FrameRecorder::METRIC_FRAME));
+	if (options_.frame_stats || DEBUG_FRAME_TIME) {
+		frame_recorder_.Report(true);
+	}
+	if (input_latency_.IsEnabled()) {
+		input_latency_.Report(true);
+	}
+	if (!options_.startup_csv.empty()) {
+		StartupTimer* startup_timer = StartupTimer::GetInstance();
+		startup_timer->Report();
+		startup_timer->AppendCsv(options_.startup_csv, N_MESHES,
+			N_VERTICES == 144 ? "solid" : "wire");
+	}
+	if (IsReplaying() || camera_recording_.IsRecording()) {
+		printf("Final view hash: %016llx\n", static_cast<unsigned long long>(
+			CameraPath::HashView(camera_.getView())));
+	}
+	if (camera_recording_.IsRecording()) {
+		camera_recording_.Save(options_.record_path);
+		camera_recording_.StopRecording();
+	}
+	if (!options_.headless) {
+		DestroyWindow();
 	}
-	DestroyWindow();
 }
 
 VkBool32 App::on_validation_callback(VkDebugReportFlagsEXT message_flags,
@@ -4,28 +4,137 @@
 // Imports.
 #include <chrono>
 #include <memory>
+#include <string>
+// Before the Anvil headers, which define nullptr as NULL on Linux.
+#include <mutex>
+#include <thread>
 #include "misc/window.h"
 #include "wrappers/instance.h"
 #include "wrappers/queue.h"
 #include "wrappers/rendering_surface.h"
 #include "wrappers/swapchain.h"
 #include "misc/time.h"
+#include "block_slots.h"
 #include "camera.h"
+#include "frame_limiter.h"
+#include "frame_recorder.h"
+#include "input_latency.h"
+#include "mapped_buffers.h"
+#include "memory_budget.h"
+#include "pipeline_stats.h"
+#include "profiler.h"
+#include "scene_loader.h"
+#include "scene_watcher.h"
+#include "simulation.h"
+#include "staging_uploader.h"
+#include "startup_timer.h"
 #include "terrain.h"
 #include "Window.h"
 
 // Global variables.
 #define N_SWAPCHAIN_IMAGES 3
 
+// Optional settings, given as "--name[=value]" arguments on the command line.
+struct AppOptions {
+	AppOptions()
+		: gpu_profile(false), pipeline_stats(false), shader_counters(false),
+		frame_stats(false), headless(false), headless_frames(1000),
+		snapshots(false), snapshot_prefix("4d_explore"), wireframe(false),
+		watch_scene(false), present_mode(VK_PRESENT_MODE_FIFO_KHR),
+		frames_in_flight(2), max_fps(0), input_latency(false) {}
+
+	// Record GPU timestamps around every pass of the frame.
+	bool gpu_profile;
+
+	// CSV file receiving per-frame GPU pass timings. Implies gpu_profile.
+	std::string gpu_profile_log;
+
+	// Query vertex, geometry shader and clipping statistics every frame.
+	bool pipeline_stats;
+
+	// Build the shaders with atomic counters for processed blocks and emitted
+	// and culled primitives.
+	bool shader_counters;
+
+	// Print frame time percentiles periodically and on exit.
+	bool frame_stats;
+
+	// File receiving every frame time report as a JSON line. Implies
+	// frame_stats.
+	std::string frame_stats_log;
+
+	// Render headless_frames frames into offscreen images instead of a
+	// window. Needs no display, so it also works on software drivers.
+	bool headless;
+	uint32_t headless_frames;
+
+	// In headless mode, store every rendered frame as
+	// "<snapshot_prefix>_<frame>.png".
+	bool snapshots;
+	std::string snapshot_prefix;
+
+	// Drive the camera from a path file instead of user input, for as many
+	// frames as the path lasts. Implies frame_stats.
+	std::string camera_path;
+
+	// Record the session's camera movement to a path file on exit.
+	std::string record_path;
+
+	// Start in the wireframe render mode.
+	bool wireframe;
+
+	// File receiving one CSV row of startup phase times per run.
+	std::string startup_csv;
+
+	// In a window, reload the scene file whenever it changes on disk.
+	bool watch_scene;
+
+	// Presentation mode of the window's swapchain. Falls back to FIFO, which
+	// every surface supports, if the surface lacks it.
+	VkPresentModeKHR present_mode;
+
+	// Frames the CPU may record and submit before waiting for the GPU to
+	// finish the oldest one, between 1 and N_SWAPCHAIN_IMAGES.
+	uint32_t frames_in_flight;
+
+	// In a window, start frames no faster than this rate; 0 for no limit.
+	double max_fps;
+
+	// Report the latency from every input event to the present of the first
+	// frame reflecting it.
+	bool input_latency;
+};
+
 class App {
 public:
 
 	// Create the visualizer app.
-	App(int width, int height, std::vector<Terrain::Block*> blocks);
+	App(int width, int height, std::vector<Terrain::Block*> blocks,
+		const AppOptions& options = AppOptions());
+	App(int width, int height, std::vector<glm::ivec4> block_positions,
+		const AppOptions& options = AppOptions());
+
+	// Create the app for a scene that loads in the background. Rendering starts
+	// right away, and loaded blocks join the scene over the following frames.
+	App(int width, int height, std::unique_ptr<SceneLoader> scene_loader,
+		const AppOptions& options = AppOptions());
 	void init();
 	void run();
 	void ToggleRenderMode();
 
+	// Remove the block the view is centered on, or place one against it.
+	void RemoveTargetBlock();
+	void PlaceTargetBlock();
+
+	const GpuProfiler& GetGpuProfiler() const { return gpu_profiler_; }
+	const PipelineStats& GetPipelineStats() const { return pipeline_stats_; }
+	const FrameRecorder& GetFrameRecorder() const { return frame_recorder_; }
+	bool IsReplaying() const { return camera_path_.GetFrameCount() > 0; }
+
+	// Called by the input callbacks for every camera input. Ignored unless
+	// the simulation runs.
+	void OnCameraInput(Simulation::InputEvent event);
+
 private:
 
 	// Field variables.
@@ -44,6 +153,7 @@ private:
 	VkDeviceSize ub_data_size_per_swapchain_image_;
 	VkDeviceSize comp_per_swap_;
 	Camera camera_;
+	AppOptions options_;
 
 	// Boilerplate initialization.
 	void init_vulkan();
@@ -55,14 +165,55 @@ private:
 	void init_window();
 
 	// Scene mesh initialization.
-	std::vector<Terrain::Block*> blocks_;
+	std::vector<glm::ivec4> block_positions_;
 	void init_meshes();
 
+	// Background scene loading. Every frame appends up to a fixed number of
+	// loaded blocks to the scene.
+	std::unique_ptr<SceneLoader> scene_loader_;
+	std::vector<glm::vec4> scene_batch_;
+	bool append_scene_blocks(size_t max_blocks, bool wait);
+
+	// Hot reloading of the scene file. The watcher starts from the blocks the
+	// file was loaded with, collected while it loads.
+	std::unique_ptr<SceneWatcher> scene_watcher_;
+	std::vector<glm::ivec4> loaded_scene_;
+	void apply_scene_patches();
+
+	// Block editing, backed by a free-list of input buffer slots. Only the
+	// slots changed since the last frame, by edits or by loading, are
+	// uploaded, by that frame's submission.
+	BlockSlots block_slots_;
+	std::vector<size_t> dirty_slots_;
+	void place_block(const glm::ivec4& position);
+	void remove_block(const glm::ivec4& position);
+	void reserve_block_slots();
+	void upload_block_slots();
+
+	// Recreate the buffers, shaders and pipelines after a change to the render
+	// mode or the scene capacity.
+	void recreate_rendering();
+
 	// Buffer initialization with helpers.
 	std::shared_ptr<Anvil::Buffer> data_buffer_ptr_;
 	std::shared_ptr<Anvil::Buffer> mesh_data_buffer_ptr_;
 	std::shared_ptr<Anvil::Buffer> comp_data_buffer_ptr_;
 	void init_buffers();
+	void init_draw_arguments();
+
+	// Every buffer is allocated through memory_allocator_, or through
+	// mapped_memory_allocator_ if it is written from the host, and tracked by
+	// memory_budget_.
+	std::shared_ptr<Anvil::MemoryAllocator> memory_allocator_;
+	std::shared_ptr<Anvil::MemoryAllocator> mapped_memory_allocator_;
+	std::vector<std::shared_ptr<Anvil::Buffer>> unbaked_buffers_;
+	bool has_unbaked_buffers_;
+	bool has_unbaked_mapped_buffers_;
+	MemoryBudget memory_budget_;
+	void add_buffer(const std::shared_ptr<Anvil::Buffer>& buffer,
+		Anvil::MemoryFeatureFlags memory_features);
+	void bake_buffers();
+	void map_frame_buffers();
 
 	// Descriptor set group initialization with helpers.
 	std::shared_ptr<Anvil::DescriptorSetGroup> dsg_ptr_;
@@ -73,9 +224,14 @@ private:
 	// Image initialization.
 	void init_images();
 
-	// Semaphore handling and initialization with helpers.
+	// Semaphore handling and initialization with helpers. Every frame in
+	// flight has its own semaphores and a fence signalled when the GPU has
+	// finished the frame; images_in_flight_ holds the fence of the last frame
+	// that rendered to each swapchain image.
 	std::vector<std::shared_ptr<Anvil::Semaphore>> frame_signal_semaphores_;
 	std::vector<std::shared_ptr<Anvil::Semaphore>> frame_wait_semaphores_;
+	std::vector<std::shared_ptr<Anvil::Fence>> frame_fences_;
+	VkFence images_in_flight_[N_SWAPCHAIN_IMAGES];
 	void init_semaphores();
 
 	// Shader initialization and supporting helpers.
@@ -107,6 +263,39 @@ private:
 	std::shared_ptr<Anvil::PrimaryCommandBuffer> command_buffers_[N_SWAPCHAIN_IMAGES];
 	void init_command_buffers();
 
+	// Vulkan handles of the objects draw_frame uses, so that a frame neither
+	// allocates nor touches the reference counts of Anvil objects. Refreshed
+	// whenever the command buffers are recorded.
+	struct FrameHandles {
+		VkDevice device;
+		VkQueue universal_queue;
+		VkQueue present_queue;
+		VkSwapchainKHR swapchain;
+		PFN_vkAcquireNextImageKHR acquire_next_image;
+		PFN_vkQueuePresentKHR queue_present;
+		VkSemaphore signal_semaphores[N_SWAPCHAIN_IMAGES];
+		VkSemaphore wait_semaphores[N_SWAPCHAIN_IMAGES];
+		VkFence frame_fences[N_SWAPCHAIN_IMAGES];
+		VkCommandBuffer command_buffers[N_SWAPCHAIN_IMAGES];
+	};
+	FrameHandles frame_handles_;
+	void init_frame_handles();
+
+	// CPU frame rate cap of the windowed run loop.
+	FrameLimiter frame_limiter_;
+
+	// Latency from input events to the present of the frames reflecting them.
+	InputLatency input_latency_;
+
+	// Heap allocations of the render thread up to the end of the last frame.
+	uint64_t n_frame_allocations_;
+
+	// GPU timestamp profiling and pipeline statistics of the recorded passes.
+	GpuProfiler gpu_profiler_;
+	PipelineStats pipeline_stats_;
+	FrameRecorder frame_recorder_;
+	void init_profiler();
+
 	// Frame validation.
 	static VkBool32 on_validation_callback(VkDebugReportFlagsEXT message_flags,
 		VkDebugReportObjectTypeEXT object_type,
@@ -118,23 +307,64 @@ private:
 
 	// Input.
 	void init_camera();
-	void handle_keys();
 
-	// Create a pointer to a buffer for storing the output cube vertices.
-	VkDeviceSize outputCubeVerticesBufferSize_;
-	std::vector<VkDeviceSize> outputCubeVerticesBufferSizes_;
-	std::shared_ptr<Anvil::Buffer> outputCubeVerticesBufferPointer_;
+	// Scripted camera path being replayed and the session being recorded.
+	CameraPath camera_path_;
+	CameraPath camera_recording_;
 
-	// Create a pointer to a buffer for sending input cube vertices to the compute
-	// shader buffer.
-	VkDeviceSize totalInputCubeBufferSize_;
-	std::vector<VkDeviceSize> inputCubeElementOffsets_;
-	std::shared_ptr<Anvil::Buffer> inputCubeBufferPointer_;
+	// Fixed-timestep camera movement of interactive sessions. Declared after
+	// the camera and recording it updates, so that it stops first.
+	Simulation simulation_;
+
+	// The scene is stored in chunks of CHUNK_MESHES slots. Every chunk has its
+	// own buffers of input cube centers and output cube vertices, descriptor
+	// sets, dispatch and draw, so no buffer range exceeds the device's
+	// maxStorageBufferRange however large the scene is. The input buffer holds
+	// centers relative to the chunk's origin in block_slots_, the center of the
+	// region of space its blocks are from, so they stay within
+	// BlockSlots::kRegionSize / 2 of it on every axis.
+	struct SceneChunk {
+		std::shared_ptr<Anvil::Buffer> input_buffer;
+		std::shared_ptr<Anvil::Buffer> output_buffer;
+		std::shared_ptr<Anvil::DescriptorSetGroup> compute_dsg;
+		std::shared_ptr<Anvil::DescriptorSetGroup> dsg;
+	};
+	std::vector<SceneChunk> scene_chunks_;
+	// Largest chunk the device supports; CHUNK_MESHES is smaller for scenes
+	// that fit in one chunk.
+	int device_chunk_meshes_;
+	void add_scene_chunks(size_t n_chunks);
+	void grow_scene_chunks(size_t n_slots);
+	void init_chunk_dsgs(SceneChunk* chunk);
+	void write_slots(size_t first_slot, size_t n_slots,
+		const glm::vec4* centers);
+	// Chunk-relative centers being written, kept to reuse its memory.
+	std::vector<glm::vec4> relative_centers_;
+
+	// Per swapchain image dispatch and draw arguments of every chunk,
+	// rewritten every frame as the scene grows.
+	VkDeviceSize drawArgumentsStride_;
+	VkDeviceSize drawArgumentsSizePerSwapchain_;
+	std::shared_ptr<Anvil::Buffer> drawArgumentsBufferPointer_;
+	std::vector<unsigned char> draw_arguments_;
 
 	VkDeviceSize mat5UniformSizePerSwapchain;
 	std::shared_ptr<Anvil::Buffer> viewProjUniformPointer;
 	std::shared_ptr<Anvil::Buffer> viewMatrixUniformPointer;
 
+	// The buffers written every frame stay mapped at these addresses. Declared
+	// after the buffers so that they are unmapped first.
+	MappedBuffers mapped_buffers_;
+	unsigned char* viewProjMapped_;
+	unsigned char* viewMatrixMapped_;
+	unsigned char* drawArgumentsMapped_;
+
+	// The input buffers of the chunks are device-local, so block centers are
+	// uploaded through a staging buffer that is created once and kept mapped.
+	// Declared last so that its uploads finish before anything is released.
+	std::shared_ptr<Anvil::Buffer> staging_buffer_;
+	StagingUploader staging_uploader_;
+
 	VkSurfaceKHR surface_;
 
 	std::chrono::time_point<std::chrono::steady_clock> prev_time;
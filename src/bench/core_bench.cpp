@@ -0,0 +1,494 @@
+// Microbenchmarks for the CPU-side core of the visualizer: 5x5 matrix math,
+// camera movement with collision checks, ray casts, terrain noise and
+// generation, and scene file parsing. None of it touches Vulkan.
+//
+// Use: 4d_explore_bench [--filter=<substring>] [--min-time=<ms>] [--csv]
+//
+// Every benchmark runs with fixed inputs, growing its iteration count until
+// one batch takes at least the minimum time, and reports the time per
+// operation and the throughput in items (matrices, blocks, samples...) per
+// second.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "camera.h"
+#include "ivec4_hash.h"
+#include "mapped_file.h"
+#include "matrix.h"
+#include "openSimplex/open-simplex-noise.h"
+#include "perlin.h"
+#include "scene_binary.h"
+#include "scene_file.h"
+#include "scene_stream.h"
+#include "terrain.h"
+#include "voxel_grid.h"
+
+#include "glm/glm.hpp"
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/gtx/hash.hpp"
+#undef GLM_ENABLE_EXPERIMENTAL
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+  Options() : min_time_ms(200.0), csv(false) {}
+
+  std::string filter;
+  double min_time_ms;
+  bool csv;
+};
+
+Options g_options;
+
+// Keeps results alive so the compiler cannot drop the measured work.
+volatile float g_sink;
+
+void Consume(float value) { g_sink = g_sink + value; }
+
+void Consume(const glm::vec4& v) { Consume(v.x + v.y + v.z + v.w); }
+
+void Consume(const mat5& m) {
+  Consume(m.get_main_mat()[0]);
+  Consume(m.get_column());
+  Consume(m.get_ww());
+}
+
+// Runs op(n) with growing n until one batch is long enough, then prints the
+// cost of a single operation. Each operation processes items_per_op items.
+template <typename Op>
+void Run(const char* name, double items_per_op, Op op) {
+  if (!g_options.filter.empty() &&
+      std::string(name).find(g_options.filter) == std::string::npos) {
+    return;
+  }
+
+  op(1);  // Warm up caches and lazily initialized state.
+  uint64_t n = 1;
+  double ms = 0.0;
+  for (;;) {
+    Clock::time_point begin = Clock::now();
+    op(n);
+    ms = std::chrono::duration<double, std::milli>(Clock::now() - begin)
+             .count();
+    if (ms >= g_options.min_time_ms || n >= (1ull << 40)) {
+      break;
+    }
+    // Aim straight for the minimum time once a batch is measurable.
+    uint64_t next = n * 2;
+    if (ms > 1.0) {
+      next = static_cast<uint64_t>(n * 1.2 * g_options.min_time_ms / ms);
+    }
+    n = next > n ? next : n + 1;
+  }
+
+  double ns_per_op = ms * 1e6 / n;
+  double items_per_s = items_per_op * n / (ms * 1e-3);
+  if (g_options.csv) {
+    printf("%s,%llu,%.3f,%.1f\n", name, static_cast<unsigned long long>(n),
+           ns_per_op, items_per_s);
+  } else {
+    printf("%-28s %12llu ops %14.2f ns/op %14.0f items/s\n", name,
+           static_cast<unsigned long long>(n), ns_per_op, items_per_s);
+  }
+  fflush(stdout);
+}
+
+void BenchMatrix() {
+  Run("mat5_multiply", 1, [](uint64_t n) {
+    mat5 a = mat5::rotate(0, 3, 0.01f);
+    mat5 acc = mat5::translate(2, 0.5f);
+    for (uint64_t i = 0; i < n; ++i) {
+      acc = a * acc;
+    }
+    Consume(acc);
+  });
+
+  // Projecting points through a view-projection matrix, one vec5 product
+  // per point against the batch transform, which does four at a time.
+  const size_t kPoints = 4096;
+  const mat5 view_proj = mat5::perspective(0.5f, 1.77f, 1.0f, 0.1f, 100.0f) *
+                         mat5::rotate(0, 3, 0.3f) * mat5::translate(3, -5.0f);
+  std::vector<glm::vec4> points(kPoints);
+  for (size_t i = 0; i < kPoints; ++i) {
+    points[i] = glm::vec4(i & 15, (i >> 4) & 15, (i >> 8) & 15, i >> 12);
+  }
+  std::vector<vec5> projected(kPoints);
+  Run("mat5_transform", kPoints, [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < kPoints; ++j) {
+        const glm::vec4& p = points[j];
+        projected[j] = view_proj * vec5(p.x, p.y, p.z, p.w, 1.0f);
+      }
+    }
+    Consume(projected[n & (kPoints - 1)].get_vec());
+  });
+  Run("mat5_transform_batch", kPoints, [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      mat5::transform(view_proj, points.data(), kPoints, projected.data());
+    }
+    Consume(projected[n & (kPoints - 1)].get_vec());
+  });
+
+  Run("mat5_lookAt", 1, [](uint64_t n) {
+    glm::vec4 eye(0, 0, 0, -5);
+    const glm::vec4 look(0, 0, 0, 0);
+    const glm::vec4 up(0, 1, 0, 0);
+    const glm::vec4 right(1, 0, 0, 0);
+    for (uint64_t i = 0; i < n; ++i) {
+      eye.x = static_cast<float>(i & 1023) * 0.001f;
+      Consume(mat5::lookAt(eye, look, up, right));
+    }
+  });
+
+  Run("cross4", 1, [](uint64_t n) {
+    glm::vec4 u(1, 2, 3, 4);
+    const glm::vec4 v(0, 1, 0, 0);
+    const glm::vec4 w(0, 0, 1, 0);
+    glm::vec4 acc(0.0f);
+    for (uint64_t i = 0; i < n; ++i) {
+      u.x = static_cast<float>(i & 1023);
+      acc += cross4(u, v, w);
+    }
+    Consume(acc);
+  });
+}
+
+void BenchCamera() {
+  // An 8^4 block of terrain with the camera hovering inside an empty shell
+  // around the origin, so every move probes occupied and empty cells.
+  std::vector<glm::vec4> terrain;
+  for (int x = -4; x < 4; ++x) {
+    for (int y = -4; y < 4; ++y) {
+      for (int z = -4; z < 4; ++z) {
+        for (int w = -4; w < 4; ++w) {
+          if (std::abs(x) + std::abs(y) + std::abs(z) + std::abs(w) > 3) {
+            terrain.push_back(glm::vec4(x, y, z, w));
+          }
+        }
+      }
+    }
+  }
+
+  // Mouse look: a turn about two planes per event, as the cursor moves
+  // diagonally, followed by fetching the view as a tick does.
+  Run("camera_rotate", 2, [](uint64_t n) {
+    Camera camera;
+    camera.UpdateView();
+    for (uint64_t i = 0; i < n; ++i) {
+      camera.RotateLeft(0.001f);
+      camera.RotateUp(0.0005f);
+    }
+    Consume(camera.getView());
+  });
+
+  // Camera::ResolveCollision is private; every Move* call runs it once.
+  Run("camera_move_collision", 1, [&terrain](uint64_t n) {
+    Camera camera;
+    camera.SetEye(glm::vec4(0, 0, 0, -0.5f));
+    camera.UpdateView();
+    camera.SetTerrain(terrain);
+    for (uint64_t i = 0; i < n; ++i) {
+      if (i & 1) {
+        camera.MoveBackward(0.1f);
+      } else {
+        camera.MoveForward(0.1f);
+      }
+    }
+    Consume(camera.getView());
+  });
+
+  // Moves longer than a block, which the swept collision must stop at the
+  // first wall instead of stepping over it.
+  Run("camera_move_collision_fast", 1, [&terrain](uint64_t n) {
+    Camera camera;
+    camera.SetEye(glm::vec4(0, 0, 0, -0.5f));
+    camera.UpdateView();
+    camera.SetTerrain(terrain);
+    for (uint64_t i = 0; i < n; ++i) {
+      if (i & 1) {
+        camera.MoveBackward(2.5f);
+      } else {
+        camera.MoveForward(2.5f);
+      }
+    }
+    Consume(camera.getView());
+  });
+
+  // Single-cell membership tests: the brick grid the camera collides
+  // against, the flat hash set and the node-based std::unordered_set, over a
+  // fixed pseudo-random sequence of cells in and around the terrain.
+  const size_t kProbeMask = 8191;
+  std::vector<glm::ivec4> probes(kProbeMask + 1);
+  uint32_t state = 12345;
+  for (glm::ivec4& probe : probes) {
+    for (int i = 0; i < 4; ++i) {
+      state = state * 1664525u + 1013904223u;
+      probe[i] = static_cast<int>(state >> 28) % 10 - 5;
+    }
+  }
+
+  VoxelGrid grid;
+  FlatIvec4Set flat_set;
+  std::unordered_set<glm::ivec4> std_set;
+  for (const glm::vec4& block : terrain) {
+    grid.Set(glm::ivec4(block));
+    flat_set.Insert(glm::ivec4(block));
+    std_set.insert(glm::ivec4(block));
+  }
+  Run("terrain_lookup_grid", 1, [&grid, &probes, kProbeMask](uint64_t n) {
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      hits += grid.IsSet(probes[i & kProbeMask]);
+    }
+    Consume(static_cast<float>(hits));
+  });
+  Run("terrain_lookup_flat", 1, [&flat_set, &probes, kProbeMask](uint64_t n) {
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      hits += flat_set.Contains(probes[i & kProbeMask]);
+    }
+    Consume(static_cast<float>(hits));
+  });
+  Run("terrain_lookup_std", 1, [&std_set, &probes, kProbeMask](uint64_t n) {
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      hits += std_set.count(probes[i & kProbeMask]);
+    }
+    Consume(static_cast<float>(hits));
+  });
+}
+
+void BenchRayCast() {
+  // A 48^4 heightfield of about 2.7 million blocks, with rays cast down
+  // across it from above in pseudo-random directions, as when picking.
+  const int kSide = 48;
+  VoxelGrid grid;
+  for (int w = 0; w < kSide; ++w) {
+    for (int z = 0; z < kSide; ++z) {
+      for (int x = 0; x < kSide; ++x) {
+        const int height = 12 + (x * 7 + z * 13 + w * 5) % 16;
+        for (int y = 0; y < height; ++y) {
+          grid.Set(glm::ivec4(x, y, z, w));
+        }
+      }
+    }
+  }
+
+  const size_t kRayMask = 4095;
+  std::vector<VoxelGrid::Ray> rays(kRayMask + 1);
+  uint32_t state = 54321;
+  for (VoxelGrid::Ray& ray : rays) {
+    float values[7];
+    for (float& value : values) {
+      state = state * 1664525u + 1013904223u;
+      value = static_cast<float>(state >> 8) / (1 << 24);
+    }
+    ray.origin = glm::vec4(values[0], 1.2f, values[1], values[2]) *
+                 static_cast<float>(kSide);
+    ray.direction = glm::vec4(values[3] - 0.5f, -values[4],
+                              values[5] - 0.5f, values[6] - 0.5f);
+  }
+
+  Run("ray_cast", 1, [&grid, &rays, kRayMask](uint64_t n) {
+    VoxelGrid::RayHit hit;
+    float acc = 0.0f;
+    for (uint64_t i = 0; i < n; ++i) {
+      if (grid.CastRay(rays[i & kRayMask], 200.0f, &hit)) {
+        acc += hit.distance;
+      }
+    }
+    Consume(acc);
+  });
+
+  std::vector<VoxelGrid::RayHit> hits(rays.size());
+  Run("ray_cast_batch", static_cast<double>(rays.size()),
+      [&grid, &rays, &hits](uint64_t n) {
+        size_t n_hits = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+          n_hits += grid.CastRays(rays.data(), rays.size(), 200.0f,
+                                  hits.data());
+        }
+        Consume(static_cast<float>(n_hits));
+      });
+}
+
+void BenchNoise() {
+  Run("perlin_octave", 1, [](uint64_t n) {
+    float acc = 0.0f;
+    for (uint64_t i = 0; i < n; ++i) {
+      int x = static_cast<int>(i & 15);
+      int y = static_cast<int>((i >> 4) & 15);
+      int z = static_cast<int>((i >> 8) & 15);
+      int w = static_cast<int>((i >> 12) & 15);
+      acc += Perlin::octave(x, y, z, w, 0.5f, 2.0f);
+    }
+    Consume(acc);
+  });
+
+  struct osn_context* ctx;
+  open_simplex_noise(77374, &ctx);
+  Run("open_simplex_noise4", 1, [ctx](uint64_t n) {
+    double acc = 0.0;
+    for (uint64_t i = 0; i < n; ++i) {
+      acc += open_simplex_noise4(ctx, (i & 15) * 0.25, ((i >> 4) & 15) * 0.25,
+                                 ((i >> 8) & 15) * 0.25,
+                                 ((i >> 12) & 15) * 0.25);
+    }
+    Consume(static_cast<float>(acc));
+  });
+  open_simplex_noise_free(ctx);
+}
+
+void BenchTerrain() {
+  const int kSide = 8;
+  const double kCells = kSide * kSide * kSide * kSide;
+  const glm::ivec4 size(kSide, kSide, kSide, kSide);
+
+  Run("chunk_perlin_8^4", kCells, [&size](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      Terrain::Chunk chunk(size, 0.5f, 2.0f, 0);
+      Consume(static_cast<float>(chunk.GetBlock(glm::ivec4(0))->GetType()));
+    }
+  });
+
+  // Open simplex terrain creates a noise context per cell, so keep it small.
+  const glm::ivec4 small_size(4, 4, 4, 4);
+  Run("chunk_opensimplex_4^4", 4 * 4 * 4 * 4, [&small_size](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      Terrain::Chunk chunk(small_size, 0.5f, 2.0f, 1);
+      Consume(static_cast<float>(chunk.GetBlock(glm::ivec4(0))->GetType()));
+    }
+  });
+
+  Terrain::Chunk chunk(size, 0.5f, 2.0f, 0);
+  Run("chunk_get_all_blocks_8^4", kCells, [&chunk](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      std::vector<Terrain::Block*> blocks = chunk.GetAllBlocks();
+      Consume(static_cast<float>(blocks.size()));
+    }
+  });
+}
+
+void BenchSceneParse() {
+  // An in-memory 24^4 scene in the scenes/ file format, large enough to be
+  // split across threads.
+  const int kSide = 24;
+  std::string text;
+  char line[64];
+  for (int x = 0; x < kSide; ++x) {
+    for (int y = 0; y < kSide; ++y) {
+      for (int w = 0; w < kSide; ++w) {
+        for (int z = 0; z < kSide; ++z) {
+          snprintf(line, sizeof(line), "%d %d %d %d\n", x, y, w, z);
+          text += line;
+        }
+      }
+    }
+  }
+  const double kBlocks = kSide * kSide * kSide * kSide;
+
+  Run("scene_parse_24^4_1_thread", kBlocks, [&text](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      std::vector<glm::ivec4> positions;
+      SceneFile::Parse(text.data(), text.size(), &positions, nullptr, 1);
+      Consume(static_cast<float>(positions.size()));
+    }
+  });
+
+  Run("scene_parse_24^4_all_threads", kBlocks, [&text](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      std::vector<glm::ivec4> positions;
+      SceneFile::Parse(text.data(), text.size(), &positions, nullptr);
+      Consume(static_cast<float>(positions.size()));
+    }
+  });
+
+  // The same scene streamed from a file in 1 MiB chunks, as the visualizer
+  // loads it, into a destination array standing in for the GPU buffer.
+  std::vector<glm::ivec4> positions;
+  SceneFile::Parse(text.data(), text.size(), &positions, nullptr);
+  const char* kTextPath = "core_bench_scene.txt";
+  if (SceneFile::Write(kTextPath, positions)) {
+    Run("scene_stream_24^4", kBlocks, [kTextPath](uint64_t n) {
+      SceneStream::Options options;
+      options.chunk_size = 1 << 20;
+      for (uint64_t i = 0; i < n; ++i) {
+        SceneStream stream(options);
+        stream.Open(kTextPath);
+        std::vector<glm::vec4> destination(stream.GetCapacity());
+        stream.Run([&destination](uint64_t first_block,
+                                  const glm::vec4* centers, size_t n_blocks) {
+          std::copy(centers, centers + n_blocks, &destination[first_block]);
+          return true;
+        });
+        Consume(static_cast<float>(stream.GetBlockCount()));
+      }
+    });
+    remove(kTextPath);
+  }
+
+  // The same scene as a .t4d file, read back into memory.
+  const char* kBinaryPath = "core_bench_scene.t4d";
+  std::string error;
+  if (!SceneBinary::Write(kBinaryPath, positions, false, &error)) {
+    printf("Skipping .t4d decoding: %s\n", error.c_str());
+    return;
+  }
+  std::string binary;
+  {
+    MappedFile file;
+    if (file.Open(kBinaryPath)) {
+      binary.assign(file.GetData(), file.GetSize());
+    }
+  }
+  remove(kBinaryPath);
+
+  Run("scene_decode_t4d_24^4", kBlocks, [&binary](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+      std::vector<glm::ivec4> positions;
+      std::string error;
+      SceneBinary::Parse(binary.data(), binary.size(), &positions, &error);
+      Consume(static_cast<float>(positions.size()));
+    }
+  });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--filter=", 9) == 0) {
+      g_options.filter = argv[i] + 9;
+    } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+      g_options.min_time_ms = atof(argv[i] + 11);
+    } else if (strcmp(argv[i], "--csv") == 0) {
+      g_options.csv = true;
+    } else {
+      printf("Use: %s [--filter=<substring>] [--min-time=<ms>] [--csv]\n",
+             argv[0]);
+      return 1;
+    }
+  }
+
+  if (g_options.csv) {
+    printf("benchmark,ops,ns_per_op,items_per_s\n");
+  }
+  BenchMatrix();
+  BenchCamera();
+  BenchRayCast();
+  BenchNoise();
+  BenchTerrain();
+  BenchSceneParse();
+  return 0;
+}
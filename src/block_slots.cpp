@@ -0,0 +1,130 @@
+#include "block_slots.h"
+
+#include <algorithm>
+
+const float BlockSlots::kFreeCoordinate = 1.0e30f;
+const int BlockSlots::kRegionSize = 4096;
+
+namespace {
+const size_t kNoChunk = static_cast<size_t>(-1);
+
+// Index of the region around position on one axis, rounding to the nearest
+// multiple of region_size.
+int GetRegion(int position, int region_size) {
+  const int shifted = position + region_size / 2;
+  return shifted >= 0 ? shifted / region_size
+                      : (shifted - region_size + 1) / region_size;
+}
+}  // namespace
+
+BlockSlots::BlockSlots() : chunk_slots_(512), n_slots_(0) {}
+
+void BlockSlots::SetChunkSlots(size_t chunk_slots) {
+  if (chunk_slots == chunk_slots_) {
+    return;
+  }
+  std::vector<glm::ivec4> positions;
+  positions.reserve(slot_of_.Size());
+  for (const glm::vec4& center : centers_) {
+    if (center.x != kFreeCoordinate) {
+      positions.push_back(glm::ivec4(center));
+    }
+  }
+  chunk_slots_ = chunk_slots;
+  n_slots_ = 0;
+  centers_.clear();
+  slot_of_.Clear();
+  chunks_.clear();
+  regions_.clear();
+  region_of_.Clear();
+  dirty_slots_.clear();
+  for (const glm::ivec4& position : positions) {
+    Add(position);
+  }
+}
+
+void BlockSlots::Reserve(size_t n_blocks) {
+  centers_.reserve(n_blocks);
+  slot_of_.Reserve(n_blocks);
+}
+
+void BlockSlots::Append(const glm::vec4* centers, size_t n_blocks) {
+  for (size_t n_block = 0; n_block < n_blocks; ++n_block) {
+    Add(glm::ivec4(centers[n_block]));
+  }
+}
+
+bool BlockSlots::Add(const glm::ivec4& position) {
+  if (slot_of_.Contains(position)) {
+    return false;
+  }
+  const size_t slot = TakeSlot(position);
+  slot_of_.Insert(position, slot);
+  centers_[slot] = glm::vec4(position);
+  dirty_slots_.push_back(slot);
+  return true;
+}
+
+bool BlockSlots::Remove(const glm::ivec4& position) {
+  const size_t* found = slot_of_.Find(position);
+  if (found == nullptr) {
+    return false;
+  }
+  size_t slot = *found;
+  slot_of_.Erase(position);
+  centers_[slot] = glm::vec4(kFreeCoordinate);
+  regions_[chunks_[slot / chunk_slots_].region].free_slots.push_back(slot);
+  dirty_slots_.push_back(slot);
+  return true;
+}
+
+void BlockSlots::TakeDirtySlots(std::vector<size_t>* slots) {
+  // Blocks appended to a single region are already in order.
+  if (!std::is_sorted(dirty_slots_.begin(), dirty_slots_.end())) {
+    std::sort(dirty_slots_.begin(), dirty_slots_.end());
+  }
+  dirty_slots_.erase(std::unique(dirty_slots_.begin(), dirty_slots_.end()),
+                     dirty_slots_.end());
+  slots->swap(dirty_slots_);
+  dirty_slots_.clear();
+}
+
+// Returns a free slot of the region of position, the next unused slot of
+// its last chunk, or the first slot of a new chunk.
+size_t BlockSlots::TakeSlot(const glm::ivec4& position) {
+  const glm::ivec4 key(GetRegion(position.x, kRegionSize),
+                       GetRegion(position.y, kRegionSize),
+                       GetRegion(position.z, kRegionSize),
+                       GetRegion(position.w, kRegionSize));
+  size_t n_region = regions_.size();
+  const size_t* found = region_of_.Find(key);
+  if (found != nullptr) {
+    n_region = *found;
+  } else {
+    Region region;
+    region.last_chunk = kNoChunk;
+    regions_.push_back(region);
+    region_of_.Insert(key, n_region);
+  }
+
+  Region& region = regions_[n_region];
+  if (!region.free_slots.empty()) {
+    const size_t slot = region.free_slots.back();
+    region.free_slots.pop_back();
+    return slot;
+  }
+  if (region.last_chunk == kNoChunk ||
+      chunks_[region.last_chunk].n_slots == chunk_slots_) {
+    Chunk chunk;
+    chunk.origin = key * kRegionSize;
+    chunk.n_slots = 0;
+    chunk.region = n_region;
+    region.last_chunk = chunks_.size();
+    chunks_.push_back(chunk);
+    centers_.resize(chunks_.size() * chunk_slots_,
+                    glm::vec4(kFreeCoordinate));
+  }
+  Chunk& chunk = chunks_[region.last_chunk];
+  ++n_slots_;
+  return region.last_chunk * chunk_slots_ + chunk.n_slots++;
+}
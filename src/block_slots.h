@@ -0,0 +1,111 @@
+// Slot layout of the blocks in the GPU input buffers. Every block has a fixed
+// slot holding its center. Removing a block marks its slot free with a
+// sentinel center, which the compute shader skips, and placing a block
+// reuses a free slot before growing the layout, so an edit changes a single
+// slot and never moves other blocks.
+//
+// Slots are grouped in chunks of a fixed number of slots, one per GPU chunk.
+// Space is divided into regions of kRegionSize^4 cells centered on multiples
+// of kRegionSize, and a chunk only holds blocks of one region, so the GPU can
+// store centers relative to the region's center with at most kRegionSize / 2
+// on any axis, which float represents with plenty of fractional precision
+// left, however far from the world origin the region is.
+//
+// The slots written since the last upload are tracked so that only those
+// are copied to the GPU.
+
+#ifndef BLOCK_SLOTS_H_
+#define BLOCK_SLOTS_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "ivec4_hash.h"
+
+class BlockSlots {
+ public:
+  // Every coordinate of a free slot's center. Also given to the compute
+  // shader as FREE_SLOT.
+  static const float kFreeCoordinate;
+
+  // Side of the regions of space whose blocks share chunks.
+  static const int kRegionSize;
+
+  // Until SetChunkSlots() is called, chunks have 512 slots.
+  BlockSlots();
+
+  // Lays the slots out in chunks of chunk_slots slots. Blocks already placed
+  // move to new slots, and every slot is marked dirty.
+  void SetChunkSlots(size_t chunk_slots);
+  size_t GetChunkSlots() const { return chunk_slots_; }
+
+  void Reserve(size_t n_blocks);
+
+  // Places blocks in free or new slots. Repeated blocks are skipped.
+  void Append(const glm::vec4* centers, size_t n_blocks);
+
+  // Places a block in a free or new slot of its region's chunks. Returns
+  // false if it is already there.
+  bool Add(const glm::ivec4& position);
+
+  // Frees the slot of a block. Returns false if there is no such block.
+  bool Remove(const glm::ivec4& position);
+
+  bool Contains(const glm::ivec4& position) const {
+    return slot_of_.Contains(position);
+  }
+
+  size_t GetChunkCount() const { return chunks_.size(); }
+
+  // The center of the chunk's region, which the GPU stores the centers of
+  // the chunk's blocks relative to.
+  const glm::ivec4& GetChunkOrigin(size_t chunk) const {
+    return chunks_[chunk].origin;
+  }
+
+  // Slots of the chunk up to the last one ever used, in use or free; the GPU
+  // processes this many.
+  size_t GetChunkSlotCount(size_t chunk) const {
+    return chunks_[chunk].n_slots;
+  }
+
+  // Slots the GPU processes over all chunks.
+  size_t GetSlotCount() const { return n_slots_; }
+  size_t GetBlockCount() const { return slot_of_.Size(); }
+
+  // Center of every slot of every chunk, in slot order, with the slots of
+  // chunk n starting at n * GetChunkSlots().
+  const std::vector<glm::vec4>& GetCenters() const { return centers_; }
+
+  // Moves the slots written since the last call into slots, in increasing
+  // order.
+  void TakeDirtySlots(std::vector<size_t>* slots);
+
+ private:
+  struct Chunk {
+    glm::ivec4 origin;
+    size_t n_slots;
+    size_t region;
+  };
+
+  // The free slots of a region's chunks, and the last chunk opened for it,
+  // the only one of them that may have slots never used.
+  struct Region {
+    std::vector<size_t> free_slots;
+    size_t last_chunk;
+  };
+
+  size_t TakeSlot(const glm::ivec4& position);
+
+  size_t chunk_slots_;
+  size_t n_slots_;
+  std::vector<glm::vec4> centers_;
+  FlatIvec4Map<size_t> slot_of_;
+  std::vector<Chunk> chunks_;
+  std::vector<Region> regions_;
+  FlatIvec4Map<size_t> region_of_;
+  std::vector<size_t> dirty_slots_;
+};
+
+#endif  // BLOCK_SLOTS_H_
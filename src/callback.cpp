@@ -10,9 +10,48 @@ Callback* Callback::GetInstance() {
   return &instance;
 }
 
-void Callback::init(App* app, Camera* camera, GLFWwindow* window) {
+namespace {
+// Returns false for keys that do not move the camera.
+bool GetKeyOp(int key, CameraPath::Op* op) {
+  switch (key) {
+    case GLFW_KEY_W:
+      *op = CameraPath::OP_MOVE_FORWARD;
+      return true;
+    case GLFW_KEY_S:
+      *op = CameraPath::OP_MOVE_BACKWARD;
+      return true;
+    case GLFW_KEY_A:
+      *op = CameraPath::OP_MOVE_LEFT;
+      return true;
+    case GLFW_KEY_D:
+      *op = CameraPath::OP_MOVE_RIGHT;
+      return true;
+    case GLFW_KEY_Q:
+      *op = CameraPath::OP_MOVE_ANA;
+      return true;
+    case GLFW_KEY_E:
+      *op = CameraPath::OP_MOVE_KATA;
+      return true;
+    case GLFW_KEY_R:
+      *op = CameraPath::OP_MOVE_UP;
+      return true;
+    case GLFW_KEY_F:
+      *op = CameraPath::OP_MOVE_DOWN;
+      return true;
+    case GLFW_KEY_1:
+      *op = CameraPath::OP_ROLL_LEFT;
+      return true;
+    case GLFW_KEY_3:
+      *op = CameraPath::OP_ROLL_RIGHT;
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+void Callback::init(App* app, GLFWwindow* window) {
   app_ = app;
-  camera_ = camera;
   scroll_pos_ = 0;
   glfwGetCursorPos(window, &last_x_pos_, &last_y_pos_);
   is_paused_ = false;
@@ -21,14 +60,17 @@ void Callback::init(App* app, Camera* camera, GLFWwindow* window) {
 void Callback::on_keypress_event_impl(GLFWwindow* window, int key, int scanCode,
                                       int action, int mods) {
   //std::cout << (char)key << " " << action << "\n";
+  CameraPath::Op op;
   if (action == GLFW_PRESS) {
     if (key == GLFW_KEY_ESCAPE) {
       glfwSetWindowShouldClose(window, true);
-      keys_.clear();
+      send_camera_input(Simulation::InputEvent::RELEASE_ALL,
+                        CameraPath::OP_MOVE_FORWARD, 0.0f);
       return;
     }
     if (key == GLFW_KEY_P) {
-      keys_.clear();
+      send_camera_input(Simulation::InputEvent::RELEASE_ALL,
+                        CameraPath::OP_MOVE_FORWARD, 0.0f);
       is_paused_ = !is_paused_;
       if (is_paused_) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -37,21 +79,29 @@ void Callback::on_keypress_event_impl(GLFWwindow* window, int key, int scanCode,
         glfwGetCursorPos(window, &last_x_pos_, &last_y_pos_);
       }
     }
-    if (!is_paused_) {
-      keys_.insert(key);
+    if (!is_paused_ && GetKeyOp(key, &op)) {
+      send_camera_input(Simulation::InputEvent::HOLD, op, 0.0f);
     }
   } else if (action == GLFW_RELEASE) {
     if (key == GLFW_KEY_T) {
       app_->ToggleRenderMode();
     }
-    if (keys_.count(key) == 1) {
-      keys_.erase(keys_.find(key));
+    if (GetKeyOp(key, &op)) {
+      send_camera_input(Simulation::InputEvent::RELEASE, op, 0.0f);
     }
   }
 }
 
 void Callback::on_mouse_button_event_impl(GLFWwindow* window, int button,
                                           int action, int mods) {
+  // Edit the block at the center of the view.
+  if (action == GLFW_PRESS && !is_paused_) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+      app_->RemoveTargetBlock();
+    } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+      app_->PlaceTargetBlock();
+    }
+  }
   //std::cout << "Mouse: " << button << "\n";
   //if (button == GLFW_MOUSE_BUTTON_1) {
   //  if (action == GLFW_PRESS) {
@@ -68,14 +118,22 @@ void Callback::on_mouse_move_event_impl(GLFWwindow* window, double xPos,
   //std::cout << "(" << last_x_pos_ << ", " << last_y_pos_ << ")\n";
   if (!is_paused_) {
     if (xPos < last_x_pos_) {
-      camera_->RotateLeft(MOUSE_SCALE * (last_x_pos_ - xPos));
+      send_camera_input(Simulation::InputEvent::APPLY,
+                        CameraPath::OP_ROTATE_LEFT,
+                        MOUSE_SCALE * (last_x_pos_ - xPos));
     } else if (xPos > last_x_pos_) {
-      camera_->RotateRight(MOUSE_SCALE * (xPos - last_x_pos_));
+      send_camera_input(Simulation::InputEvent::APPLY,
+                        CameraPath::OP_ROTATE_RIGHT,
+                        MOUSE_SCALE * (xPos - last_x_pos_));
     }
     if (yPos < last_y_pos_) {
-      camera_->RotateUp(MOUSE_SCALE * (last_y_pos_ - yPos));
+      send_camera_input(Simulation::InputEvent::APPLY,
+                        CameraPath::OP_ROTATE_UP,
+                        MOUSE_SCALE * (last_y_pos_ - yPos));
     } else if (yPos > last_y_pos_) {
-      camera_->RotateDown(MOUSE_SCALE * (yPos - last_y_pos_));
+      send_camera_input(Simulation::InputEvent::APPLY,
+                        CameraPath::OP_ROTATE_DOWN,
+                        MOUSE_SCALE * (yPos - last_y_pos_));
     }
 
     last_x_pos_ = xPos;
@@ -87,5 +145,16 @@ void Callback::on_mouse_scroll_event_impl(GLFWwindow* window, double xOffset,
                                           double yOffset) {
   //std::cout << yOffset << "\n";
   scroll_pos_ += yOffset;
-  camera_->RotateAna(SCROLL_SCALE * yOffset);
+  send_camera_input(Simulation::InputEvent::APPLY, CameraPath::OP_ROTATE_ANA,
+                    SCROLL_SCALE * yOffset);
+}
+
+void Callback::send_camera_input(Simulation::InputEvent::Type type,
+                                 CameraPath::Op op, float amount) {
+  Simulation::InputEvent event;
+  event.type = type;
+  event.op = op;
+  event.amount = amount;
+  event.ordinal = 0;
+  app_->OnCameraInput(event);
 }
@@ -2,9 +2,7 @@
 #define CALLBACK_H_
 
 #include "app.h"
-#include "camera.h"
-
-#include <unordered_set>
+#include "camera_path.h"
 
 #include "GLFW/glfw3.h"
 
@@ -12,9 +10,7 @@ class Callback {
  public:
   static Callback* GetInstance();
 
-  void init(App* app, Camera* camera, GLFWwindow* window);
-
-  const std::unordered_set<int>* get_keys() { return &keys_; }
+  void init(App* app, GLFWwindow* window);
 
   static void on_keypress_event(GLFWwindow* window, int key, int scanCode,
                                 int action, int mods) {
@@ -46,9 +42,12 @@ class Callback {
   void on_mouse_scroll_event_impl(GLFWwindow* window, double xOffset,
                                   double yOffset);
 
+  // Camera inputs, which the callbacks hand to the simulation thread
+  // instead of moving the camera themselves.
+  void send_camera_input(Simulation::InputEvent::Type type, CameraPath::Op op,
+                         float amount);
+
   App* app_;
-  Camera* camera_;
-  std::unordered_set<int> keys_;
   double scroll_pos_;
   double last_x_pos_;
   double last_y_pos_;
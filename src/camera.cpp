@@ -1,5 +1,9 @@
 #include "camera.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "matrix.h"
 
 Camera::Camera()
@@ -12,13 +16,27 @@ Camera::Camera()
       aspectW_(1),
       zNear_(0.1),
       zFar_(100),
-      radius_(1) {}
+      radius_(1),
+      position_(eye_),
+      handedness_(1.0f),
+      recorder_(nullptr) {}
 
 void Camera::SetTerrain(std::vector<glm::vec4>& t) {
-  terrain_.clear();
-  //std::copy(t.begin(), t.end(), std::inserter(terrain_, terrain_.end()));
+  terrain_.Clear();
   for (glm::vec4 v : t) {
-    terrain_.insert(glm::ivec4(v));
+    terrain_.Set(glm::ivec4(v));
+  }
+}
+
+void Camera::AddTerrain(const glm::vec4* blocks, size_t n_blocks) {
+  for (size_t i = 0; i < n_blocks; ++i) {
+    terrain_.Set(glm::ivec4(blocks[i]));
+  }
+}
+
+void Camera::RemoveTerrain(const glm::vec4* blocks, size_t n_blocks) {
+  for (size_t i = 0; i < n_blocks; ++i) {
+    terrain_.Reset(glm::ivec4(blocks[i]));
   }
 }
 
@@ -31,12 +49,34 @@ void Camera::SetUpDir(glm::vec4 up) { up_ = up; }
 void Camera::SetRightDir(glm::vec4 right) { right_ = right; }
 
 void Camera::UpdateView() {
-  //rot_matrix_ =
-  //    mat5::lookAt(glm::vec4(0, 0, 0, 0), glm::vec4(0, 0, 0, 1), up_, right_);
-  //trans_matrix_ = mat5::translate(3, -5);
-  //rot_matrix_ =
-  //    mat5::lookAt(eye_, look_, up_, right_);
-  view_matrix_ = mat5::lookAt(eye_, look_, up_, right_);
+  // mat5::lookAt mirrors the ana axis. A rotor only holds rotations, so the
+  // mirror is kept apart and applied to the world axes of the view.
+  glm::mat4 rotation = mat5::lookAt(eye_, look_, up_, right_).get_main_mat();
+  handedness_ = glm::vec4(1.0f);
+  if (glm::determinant(rotation) < 0.0f) {
+    handedness_[2] = -1.0f;
+    rotation[2] = -rotation[2];
+  }
+  orientation_ = Rotor4::FromMatrix(rotation);
+  position_ = glm::dvec4(eye_);
+}
+
+mat5 Camera::getView() const {
+  const glm::mat4 rotation = GetViewRotation();
+  return mat5::rigid(rotation,
+                     glm::vec4(-(glm::dmat4(rotation) * position_)));
+}
+
+mat5 Camera::GetRelativeView() const {
+  return mat5::rigid(GetViewRotation(), glm::vec4(0.0f));
+}
+
+glm::mat4 Camera::GetViewRotation() const {
+  glm::mat4 rotation = orientation_.ToMatrix();
+  for (int i = 0; i < 4; ++i) {
+    rotation[i] *= handedness_[i];
+  }
+  return rotation;
 }
 
 void Camera::SetFovy(float fovy) { fovy_ = fovy; }
@@ -54,176 +94,297 @@ void Camera::UpdateProj() {
       mat5::perspective(fovy_, aspectX_, aspectW_, zNear_, zFar_);
 }
 
+void Camera::RotateView(int axis_a, int axis_b, float angle) {
+  orientation_ = Rotor4::FromPlane(axis_a, axis_b, angle) * orientation_;
+  orientation_.Normalize();
+}
+
+void Camera::TranslateView(int axis, float amount) {
+  position_ -= static_cast<double>(amount) * glm::dvec4(GetViewAxis(axis));
+}
+
+glm::vec4 Camera::GetViewAxis(int axis) const {
+  // The rows of the view rotation, which the inverse rotor turns the view
+  // axes back into.
+  glm::vec4 view_axis(0.0f);
+  view_axis[axis] = 1.0f;
+  return handedness_ * orientation_.Reverse().Rotate(view_axis);
+}
+
 #define SENSITIVITY 2
 
 void Camera::RotateUp(float amount) {
-  mat5 rot = mat5::rotate(1, 3, SENSITIVITY * amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_UP, amount);
+  }
+  RotateView(1, 3, SENSITIVITY * amount);
 }
 
 void Camera::RotateDown(float amount) {
-  mat5 rot = mat5::rotate(1, 3, SENSITIVITY * -amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_DOWN, amount);
+  }
+  RotateView(1, 3, SENSITIVITY * -amount);
 }
 
 void Camera::RotateRight(float amount) {
-  mat5 rot = mat5::rotate(0, 3, SENSITIVITY * -amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_RIGHT, amount);
+  }
+  RotateView(0, 3, SENSITIVITY * -amount);
 }
 
 void Camera::RotateLeft(float amount) {
-  mat5 rot = mat5::rotate(0, 3, SENSITIVITY * amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_LEFT, amount);
+  }
+  RotateView(0, 3, SENSITIVITY * amount);
 }
 
 void Camera::RotateAna(float amount) {
-  mat5 rot = mat5::rotate(2, 3, amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_ANA, amount);
+  }
+  RotateView(2, 3, amount);
 }
 
 void Camera::RotateKata(float amount) {
-  mat5 rot = mat5::rotate(2, 3, -amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROTATE_KATA, amount);
+  }
+  RotateView(2, 3, -amount);
 }
 
 void Camera::RollLeft(float amount) {
-  mat5 rot = mat5::rotate(0, 1, amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROLL_LEFT, amount);
+  }
+  RotateView(0, 1, amount);
 }
 
 void Camera::RollRight(float amount) {
-  mat5 rot = mat5::rotate(0, 1, -amount);
-  view_matrix_ = rot * view_matrix_;
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_ROLL_RIGHT, amount);
+  }
+  RotateView(0, 1, -amount);
 }
 
 void Camera::MoveForward(float amount) {
-  mat5 trans = mat5::translate(3, -amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_FORWARD, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(3, -amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveBackward(float amount) {
-  mat5 trans = mat5::translate(3, amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_BACKWARD, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(3, amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveRight(float amount) {
-  mat5 trans = mat5::translate(0, amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_RIGHT, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(0, amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveLeft(float amount) {
-  mat5 trans = mat5::translate(0, -amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_LEFT, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(0, -amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveUp(float amount) {
-  mat5 trans = mat5::translate(1, -amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_UP, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(1, -amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveDown(float amount) {
-  mat5 trans = mat5::translate(1, amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_DOWN, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(1, amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveAna(float amount) {
-  mat5 trans = mat5::translate(2, amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_ANA, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(2, amount);
+  ResolveCollision(start);
 }
 
 void Camera::MoveKata(float amount) {
-  mat5 trans = mat5::translate(2, -amount);
-  view_matrix_ = trans * view_matrix_;
-  CheckCollision();
-}
-
-void PrintVec(const glm::vec4& v) {
-  std::cout << "(" << v[0] << ", " << v[1] << ", " << v[2] << ", " << v[3]
-            << ")\n";
+  if (recorder_ != nullptr) {
+    recorder_->Record(CameraPath::OP_MOVE_KATA, amount);
+  }
+  const glm::dvec4 start = position_;
+  TranslateView(2, -amount);
+  ResolveCollision(start);
 }
 
-void Camera::CheckCollision() {
-  glm::vec4 col = view_matrix_.get_column();
-  glm::mat4 rot = view_matrix_.get_main_mat();
-  glm::vec4 c = -col*rot;
+glm::vec4 Camera::GetPosition() const { return glm::vec4(position_); }
 
-  glm::vec4 e;
-  glm::vec4 closest_cell;
-  //PrintVec(c);
-  //std::cout << "\n";
+glm::vec4 Camera::GetForward() const {
+  // The front axis of mat5::lookAt.
+  return GetViewAxis(3);
+}
 
-  e = c + glm::vec4( radius_, 0, 0, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 + (e - closest_cell)[0];
-    mat5 trans = mat5::translate(0, amount);
-    view_matrix_ = view_matrix_*trans;
-  }
+bool Camera::CastViewRay(float max_distance, VoxelGrid::RayHit* hit) const {
+  VoxelGrid::Ray ray;
+  ray.origin = GetPosition();
+  ray.direction = GetForward();
+  return terrain_.CastRay(ray, max_distance, hit);
+}
 
-  e = c + glm::vec4(-radius_, 0, 0, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 - (e - closest_cell)[0];
-    mat5 trans = mat5::translate(0, -amount);
-    view_matrix_ = view_matrix_*trans;
+bool Camera::FindTarget(float max_distance, glm::ivec4* block,
+                        glm::ivec4* before) const {
+  VoxelGrid::RayHit hit;
+  if (!CastViewRay(max_distance, &hit)) {
+    return false;
   }
+  *block = hit.cell;
+  *before = hit.cell + hit.normal;
+  return true;
+}
 
-  e = c + glm::vec4(0, radius_, 0, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 + (e - closest_cell)[1];
-    mat5 trans = mat5::translate(1, amount);
-    view_matrix_ = view_matrix_*trans;
-  }
+bool Camera::OverlapsCell(const glm::ivec4& cell) const {
+  const glm::dvec4 distance = glm::abs(glm::dvec4(cell) - position_);
+  const double reach = 0.5 + radius_;
+  return distance.x < reach && distance.y < reach && distance.z < reach &&
+         distance.w < reach;
+}
 
-  e = c + glm::vec4(0, -radius_, 0, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 - (e - closest_cell)[1];
-    mat5 trans = mat5::translate(1, -amount);
-    view_matrix_ = view_matrix_*trans;
-  }
+void PrintVec(const glm::vec4& v) {
+  std::cout << "(" << v[0] << ", " << v[1] << ", " << v[2] << ", " << v[3]
+            << ")\n";
+}
 
-  e = c + glm::vec4(0, 0, radius_, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 + (e - closest_cell)[2];
-    mat5 trans = mat5::translate(2, amount);
-    view_matrix_ = view_matrix_*trans;
+void Camera::ResolveCollision(const glm::dvec4& start) {
+  // Sweep in coordinates relative to the cell the move starts in, which keep
+  // their precision however far the camera is from the world origin.
+  const glm::ivec4 origin(glm::round(start));
+  glm::vec4 position(start - glm::dvec4(origin));
+  glm::vec4 motion(position_ - start);
+  VoxelGrid::Cursor cursor(terrain_);
+
+  // Every blocking face removes one axis from the motion, so four sweeps
+  // resolve any move.
+  bool blocked = false;
+  for (int n_sweep = 0; n_sweep < 4; ++n_sweep) {
+    float t;
+    int axis;
+    float stop;
+    if (!SweepHypercube(position, motion, origin, &cursor, &t, &axis,
+                        &stop)) {
+      position += motion;
+      break;
+    }
+    blocked = true;
+    position += motion * t;
+    position[axis] = stop;
+    motion *= 1.0f - t;
+    motion[axis] = 0.0f;
   }
 
-  e = c + glm::vec4(0, 0, -radius_, 0);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 - (e - closest_cell)[2];
-    mat5 trans = mat5::translate(2, -amount);
-    view_matrix_ = view_matrix_*trans;
+  // An unblocked move keeps the end position in full precision.
+  if (blocked) {
+    position_ = glm::dvec4(origin) + glm::dvec4(position);
   }
+}
 
-  e = c + glm::vec4(0, 0, 0, radius_);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 + (e - closest_cell)[3];
-    mat5 trans = mat5::translate(3, amount);
-    view_matrix_ = view_matrix_ * trans;
+bool Camera::SweepHypercube(const glm::vec4& position, const glm::vec4& motion,
+                            const glm::ivec4& origin,
+                            VoxelGrid::Cursor* cursor, float* t, int* axis,
+                            float* stop) const {
+  // Gap left between the camera and a blocking face, so that the next move
+  // starts outside the face rather than on it.
+  const float kSkin = 1e-3f;
+
+  // For every axis, the next cell layer the leading face enters, and the
+  // fraction of the motion at which it enters it.
+  int step[4];
+  int layer[4];
+  float next_t[4];
+  float delta_t[4];
+  for (int i = 0; i < 4; ++i) {
+    step[i] = motion[i] > 0.0f ? 1 : -1;
+    if (motion[i] == 0.0f) {
+      layer[i] = 0;
+      next_t[i] = std::numeric_limits<float>::infinity();
+      delta_t[i] = std::numeric_limits<float>::infinity();
+      continue;
+    }
+    const float lead = position[i] + step[i] * radius_;
+    const float boundary = step[i] > 0 ? std::ceil(lead - 0.5f) + 0.5f
+                                       : std::floor(lead + 0.5f) - 0.5f;
+    layer[i] = static_cast<int>(boundary + 0.5f * step[i]);
+    next_t[i] = (boundary - lead) / motion[i];
+    delta_t[i] = std::abs(1.0f / motion[i]);
   }
 
-  e = c + glm::vec4(0, 0, 0, -radius_);
-  closest_cell = glm::ivec4(glm::round(e));
-  if (terrain_.count(closest_cell) > 0) {
-    float amount = 0.5 - (e - closest_cell)[3];
-    mat5 trans = mat5::translate(3, -amount);
-    view_matrix_ = view_matrix_ * trans;
+  for (;;) {
+    int a = 0;
+    for (int i = 1; i < 4; ++i) {
+      if (next_t[i] < next_t[a]) {
+        a = i;
+      }
+    }
+    if (next_t[a] > 1.0f) {
+      return false;
+    }
+
+    // The cells of the entered layer that overlap the hypercube on the
+    // other three axes at that moment.
+    glm::ivec4 low;
+    glm::ivec4 high;
+    for (int i = 0; i < 4; ++i) {
+      if (i == a) {
+        low[i] = high[i] = layer[a];
+        continue;
+      }
+      const float center = position[i] + motion[i] * next_t[a];
+      low[i] = static_cast<int>(std::floor(center - radius_ - 0.5f)) + 1;
+      high[i] = static_cast<int>(std::ceil(center + radius_ + 0.5f)) - 1;
+    }
+    glm::ivec4 cell;
+    for (cell.x = low.x; cell.x <= high.x; ++cell.x) {
+      for (cell.y = low.y; cell.y <= high.y; ++cell.y) {
+        for (cell.z = low.z; cell.z <= high.z; ++cell.z) {
+          for (cell.w = low.w; cell.w <= high.w; ++cell.w) {
+            if (cursor->IsSet(origin + cell)) {
+              *t = std::max(next_t[a], 0.0f);
+              *axis = a;
+              *stop = layer[a] - 0.5f * step[a] - step[a] * (radius_ + kSkin);
+              return true;
+            }
+          }
+        }
+      }
+    }
+    layer[a] += step[a];
+    next_t[a] += delta_t[a];
   }
 }
 
-mat5 Camera::GetViewProj() {
-  return projection_matrix_ * view_matrix_;
+mat5 Camera::GetViewProj() const {
+  return projection_matrix_ * getView();
 }
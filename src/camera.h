@@ -1,16 +1,15 @@
 #ifndef CAMERA_H_
 #define CAMERA_H_
 
+#include "camera_path.h"
 #include "matrix.h"
+#include "rotor4.h"
+#include "voxel_grid.h"
 
 #include <iostream>
-#include <unordered_set>
 #include <vector>
 
 #include "glm/glm.hpp"
-#define GLM_ENABLE_EXPERIMENTAL
-#include "glm/gtx/hash.hpp"
-#undef GLM_ENABLE_EXPERIMENTAL
 
 class Camera {
  public:
@@ -18,6 +17,11 @@ class Camera {
 
   void SetTerrain(std::vector<glm::vec4>& t);
 
+  // Adds or removes blocks of the terrain that collisions are checked
+  // against.
+  void AddTerrain(const glm::vec4* blocks, size_t n_blocks);
+  void RemoveTerrain(const glm::vec4* blocks, size_t n_blocks);
+
   // Only use following functions for setup. All functions must be called for
   // proper use.
   void SetEye(glm::vec4 eye);
@@ -54,18 +58,72 @@ class Camera {
   void MoveAna(float amount);
   void MoveKata(float amount);
 
-  mat5 getView() {
-    return view_matrix_;
-  }
+  // The view is built from the orientation and position on every call, so
+  // callers should fetch it once per frame or tick.
+  mat5 getView() const;
+
+  // The view of a camera at the origin with the same orientation, for
+  // rendering camera-relative positions.
+  mat5 GetRelativeView() const;
   mat5 getProj() {
     return projection_matrix_;
   }
-  mat5 GetViewProj();
+  mat5 GetViewProj() const;
+
+  // World position of the eye, and the direction the view is centered on.
+  glm::vec4 GetPosition() const;
+  glm::dvec4 GetPrecisePosition() const { return position_; }
+  glm::vec4 GetForward() const;
+
+  // Casts a ray from the eye along the center of the view through the
+  // terrain for up to max_distance, for picking and visibility queries.
+  bool CastViewRay(float max_distance, VoxelGrid::RayHit* hit) const;
+
+  // Follows the center of the view through the terrain for up to
+  // max_distance. Returns true if it hits a block, storing the block and the
+  // empty cell the view entered it from.
+  bool FindTarget(float max_distance, glm::ivec4* block,
+                  glm::ivec4* before) const;
+
+  // Whether the unit cube of a cell overlaps the camera's hypercube. A block
+  // placed there would trap the camera, since sweeps only test the cells
+  // the hypercube moves into.
+  bool OverlapsCell(const glm::ivec4& cell) const;
+
+  // The blocks collisions are checked against, for batches of ray casts.
+  const VoxelGrid& GetTerrain() const { return terrain_; }
+
+  // When set, every movement above is also appended to the given path.
+  void SetRecorder(CameraPath* recorder) { recorder_ = recorder; }
 
  private:
-  void CheckCollision();
+  // Rotate the view in a plane of view axes, and move the eye along a view
+  // axis, like multiplying mat5::rotate and mat5::translate into the view.
+  void RotateView(int axis_a, int axis_b, float angle);
+  void TranslateView(int axis, float amount);
+
+  // World direction of an axis of the view.
+  glm::vec4 GetViewAxis(int axis) const;
+
+  // The 4x4 part of the view.
+  glm::mat4 GetViewRotation() const;
+
+  // Moves the camera, which has just moved from start in a straight line,
+  // back to where the hypercube of half-width radius_ around it first hit
+  // the terrain, then lets it slide along the blocking faces for the rest of
+  // the motion.
+  void ResolveCollision(const glm::dvec4& start);
+
+  // Sweeps the camera's hypercube from position along motion through the
+  // terrain, one layer of cells at a time on whichever axis its leading
+  // faces cross next (a 4D DDA). Positions are relative to the cell origin.
+  // Returns true on the first occupied cell, storing the fraction of motion
+  // covered, the blocked axis and the coordinate at which the camera rests
+  // against the cell on that axis.
+  bool SweepHypercube(const glm::vec4& position, const glm::vec4& motion,
+                      const glm::ivec4& origin, VoxelGrid::Cursor* cursor,
+                      float* t, int* axis, float* stop) const;
 
-  mat5 view_matrix_;
   mat5 projection_matrix_;
 
   glm::vec4 eye_;
@@ -81,7 +139,18 @@ class Camera {
 
   float radius_;
 
-  std::unordered_set<glm::ivec4> terrain_;
+  // The view rotation, renormalized after every turn so that it stays
+  // orthonormal however long the session, and the eye in world space, in
+  // double precision so that moves far from the origin stay exact.
+  Rotor4 orientation_;
+  glm::dvec4 position_;
+
+  // 1, or -1 for a world axis that the view mirrors.
+  glm::vec4 handedness_;
+
+  VoxelGrid terrain_;
+
+  CameraPath* recorder_;
 };
 
 #endif  // CAMERA_H_
@@ -0,0 +1,248 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "camera.h"
+#include "matrix.h"
+
+namespace {
+const char* const kOpNames[CameraPath::N_OPS] = {
+    "forward",     "backward",     "left",       "right",
+    "up",          "down",         "ana",        "kata",
+    "rotate_up",   "rotate_down",  "rotate_left", "rotate_right",
+    "rotate_ana",  "rotate_kata",  "roll_left",  "roll_right"};
+
+void HashBytes(const void* data, size_t size, uint64_t* hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= 1099511628211ull;
+  }
+}
+}  // namespace
+
+CameraPath::CameraPath()
+    : next_step_(0), n_frames_(0), frame_(0), recording_(false) {}
+
+bool CameraPath::Load(const std::string& path) {
+  std::ifstream in(path.c_str());
+  if (!in.is_open()) {
+    fprintf(stderr, "Camera path: could not open \"%s\"\n", path.c_str());
+    return false;
+  }
+  Clear();
+  if (!Parse(in, path)) {
+    Clear();
+    return false;
+  }
+
+  // Operations on the same frame keep their file order, since rotations and
+  // collision responses do not commute.
+  std::stable_sort(steps_.begin(), steps_.end(),
+                   [](const Step& a, const Step& b) {
+                     return a.frame < b.frame;
+                   });
+  return true;
+}
+
+bool CameraPath::Parse(std::istream& in, const std::string& path) {
+  std::string line;
+  for (int line_number = 1; std::getline(in, line); ++line_number) {
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    std::istringstream fields(line);
+    std::string first;
+    if (!(fields >> first)) {
+      continue;
+    }
+
+    if (first == "frames") {
+      if (!(fields >> n_frames_)) {
+        fprintf(stderr, "%s:%d: expected a frame count\n", path.c_str(),
+                line_number);
+        return false;
+      }
+      continue;
+    }
+
+    unsigned long begin = 0;
+    unsigned long end = 0;
+    int consumed = 0;
+    if (sscanf(first.c_str(), "%lu-%lu%n", &begin, &end, &consumed) != 2) {
+      end = begin = 0;
+      if (sscanf(first.c_str(), "%lu%n", &begin, &consumed) != 1) {
+        fprintf(stderr, "%s:%d: expected a frame or frame range, got \"%s\"\n",
+                path.c_str(), line_number, first.c_str());
+        return false;
+      }
+      end = begin;
+    }
+    if (static_cast<size_t>(consumed) != first.size() || end < begin) {
+      fprintf(stderr, "%s:%d: invalid frame range \"%s\"\n", path.c_str(),
+              line_number, first.c_str());
+      return false;
+    }
+
+    std::string name;
+    Step step;
+    if (!(fields >> name) || !ParseOp(name, &step.op)) {
+      fprintf(stderr, "%s:%d: unknown camera operation \"%s\"\n",
+              path.c_str(), line_number, name.c_str());
+      return false;
+    }
+    if (!(fields >> step.amount)) {
+      fprintf(stderr, "%s:%d: expected an amount\n", path.c_str(),
+              line_number);
+      return false;
+    }
+    for (unsigned long frame = begin; frame <= end; ++frame) {
+      step.frame = static_cast<uint32_t>(frame);
+      steps_.push_back(step);
+    }
+  }
+  return true;
+}
+
+bool CameraPath::Save(const std::string& path) const {
+  FILE* out = fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "Camera path: could not write \"%s\"\n", path.c_str());
+    return false;
+  }
+  fprintf(out, "# <frame>[-<last frame>] <operation> <amount>\n");
+  fprintf(out, "frames %u\n", GetFrameCount());
+  for (const Step& step : steps_) {
+    // Nine significant digits round-trip every float exactly.
+    fprintf(out, "%u %s %.9g\n", step.frame, GetOpName(step.op), step.amount);
+  }
+  fclose(out);
+  return true;
+}
+
+void CameraPath::Clear() {
+  steps_.clear();
+  next_step_ = 0;
+  n_frames_ = 0;
+  frame_ = 0;
+}
+
+uint32_t CameraPath::GetFrameCount() const {
+  if (n_frames_ > 0) {
+    return n_frames_;
+  }
+  uint32_t n_frames = steps_.empty() ? 0 : steps_.back().frame + 1;
+  if (recording_) {
+    // The recorder's frame counts the frames rendered so far.
+    n_frames = std::max(n_frames, frame_);
+  }
+  return n_frames;
+}
+
+void CameraPath::StartRecording() {
+  Clear();
+  recording_ = true;
+}
+
+void CameraPath::Record(Op op, float amount) {
+  if (!recording_) {
+    return;
+  }
+  Step step;
+  step.frame = frame_;
+  step.op = op;
+  step.amount = amount;
+  steps_.push_back(step);
+}
+
+void CameraPath::Apply(uint32_t frame, Camera* camera) {
+  while (next_step_ < steps_.size() && steps_[next_step_].frame <= frame) {
+    const Step& step = steps_[next_step_];
+    if (step.frame == frame) {
+      ApplyOp(step.op, step.amount, camera);
+    }
+    ++next_step_;
+  }
+}
+
+void CameraPath::ApplyOp(Op op, float amount, Camera* camera) {
+  switch (op) {
+    case OP_MOVE_FORWARD:
+      camera->MoveForward(amount);
+      break;
+    case OP_MOVE_BACKWARD:
+      camera->MoveBackward(amount);
+      break;
+    case OP_MOVE_LEFT:
+      camera->MoveLeft(amount);
+      break;
+    case OP_MOVE_RIGHT:
+      camera->MoveRight(amount);
+      break;
+    case OP_MOVE_UP:
+      camera->MoveUp(amount);
+      break;
+    case OP_MOVE_DOWN:
+      camera->MoveDown(amount);
+      break;
+    case OP_MOVE_ANA:
+      camera->MoveAna(amount);
+      break;
+    case OP_MOVE_KATA:
+      camera->MoveKata(amount);
+      break;
+    case OP_ROTATE_UP:
+      camera->RotateUp(amount);
+      break;
+    case OP_ROTATE_DOWN:
+      camera->RotateDown(amount);
+      break;
+    case OP_ROTATE_LEFT:
+      camera->RotateLeft(amount);
+      break;
+    case OP_ROTATE_RIGHT:
+      camera->RotateRight(amount);
+      break;
+    case OP_ROTATE_ANA:
+      camera->RotateAna(amount);
+      break;
+    case OP_ROTATE_KATA:
+      camera->RotateKata(amount);
+      break;
+    case OP_ROLL_LEFT:
+      camera->RollLeft(amount);
+      break;
+    case OP_ROLL_RIGHT:
+      camera->RollRight(amount);
+      break;
+    default:
+      break;
+  }
+}
+
+const char* CameraPath::GetOpName(Op op) {
+  return op >= 0 && op < N_OPS ? kOpNames[op] : "unknown";
+}
+
+bool CameraPath::ParseOp(const std::string& name, Op* op) {
+  for (int i = 0; i < N_OPS; ++i) {
+    if (name == kOpNames[i]) {
+      *op = static_cast<Op>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t CameraPath::HashView(const mat5& view) {
+  uint64_t hash = 14695981039346656037ull;
+  HashBytes(&view.get_main_mat(), sizeof(glm::mat4), &hash);
+  HashBytes(&view.get_column(), sizeof(glm::vec4), &hash);
+  HashBytes(&view.get_row(), sizeof(glm::vec4), &hash);
+  HashBytes(&view.get_ww(), sizeof(float), &hash);
+  return hash;
+}
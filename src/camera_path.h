@@ -0,0 +1,102 @@
+// Scripted camera motion for reproducible benchmarks. A path is a list of
+// camera operations keyed by frame number. Replaying it applies the moves
+// one interactive simulation tick would make on every frame, so a run does
+// not depend on input timing or wall-clock time. Recorded sessions store one
+// frame per simulation tick.
+//
+// Path files are plain text with one operation per line:
+//
+//   <frame>[-<last frame>] <operation> <amount>
+//   frames <count>
+//
+// where <operation> is one of the names returned by GetOpName(), e.g.
+// "forward 0.1" or "rotate_left 0.05". A frame range repeats the operation
+// on every frame in it. "frames" sets the number of frames to render and
+// defaults to one past the last scripted frame. '#' starts a comment.
+
+#ifndef CAMERA_PATH_H_
+#define CAMERA_PATH_H_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+class Camera;
+class mat5;
+
+class CameraPath {
+ public:
+  // One operation per public Camera movement method.
+  enum Op {
+    OP_MOVE_FORWARD = 0,
+    OP_MOVE_BACKWARD,
+    OP_MOVE_LEFT,
+    OP_MOVE_RIGHT,
+    OP_MOVE_UP,
+    OP_MOVE_DOWN,
+    OP_MOVE_ANA,
+    OP_MOVE_KATA,
+    OP_ROTATE_UP,
+    OP_ROTATE_DOWN,
+    OP_ROTATE_LEFT,
+    OP_ROTATE_RIGHT,
+    OP_ROTATE_ANA,
+    OP_ROTATE_KATA,
+    OP_ROLL_LEFT,
+    OP_ROLL_RIGHT,
+    N_OPS
+  };
+
+  CameraPath();
+
+  // Replaces the path with the contents of a path file. Errors are reported
+  // with their line number and leave the path empty.
+  bool Load(const std::string& path);
+
+  // Writes the path in the format read by Load().
+  bool Save(const std::string& path) const;
+
+  void Clear();
+  bool IsEmpty() const { return steps_.empty(); }
+
+  // Number of frames a replay of this path renders.
+  uint32_t GetFrameCount() const;
+
+  // Recording. While recording, every operation passed to Record() is
+  // stored under the frame last given to SetFrame().
+  void StartRecording();
+  void StopRecording() { recording_ = false; }
+  bool IsRecording() const { return recording_; }
+  void SetFrame(uint32_t frame) { frame_ = frame; }
+  void Record(Op op, float amount);
+
+  // Applies every operation scheduled for the given frame. Frames must be
+  // replayed in increasing order.
+  void Apply(uint32_t frame, Camera* camera);
+
+  static void ApplyOp(Op op, float amount, Camera* camera);
+  static const char* GetOpName(Op op);
+
+  // FNV-1a hash over the bits of a view matrix, used to check that two
+  // replays ended in the same camera state.
+  static uint64_t HashView(const mat5& view);
+
+ private:
+  struct Step {
+    uint32_t frame;
+    Op op;
+    float amount;
+  };
+
+  bool Parse(std::istream& in, const std::string& path);
+  static bool ParseOp(const std::string& name, Op* op);
+
+  std::vector<Step> steps_;
+  size_t next_step_;
+  uint32_t n_frames_;
+  uint32_t frame_;
+  bool recording_;
+};
+
+#endif  // CAMERA_PATH_H_
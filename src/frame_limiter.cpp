@@ -0,0 +1,38 @@
+#include "frame_limiter.h"
+
+#include <thread>
+
+namespace {
+// Time left to spin rather than sleep, which covers the usual sleep
+// overshoot on desktop schedulers.
+const std::chrono::microseconds kSpinTime(1500);
+}  // namespace
+
+FrameLimiter::FrameLimiter() : period_(0), started_(false) {}
+
+void FrameLimiter::SetMaxFps(double max_fps) {
+  period_ = max_fps > 0
+                ? std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<double>(1.0 / max_fps))
+                : Clock::duration(0);
+  started_ = false;
+}
+
+void FrameLimiter::Wait() {
+  if (!IsEnabled()) {
+    return;
+  }
+  Clock::time_point now = Clock::now();
+  if (!started_ || now - deadline_ > period_) {
+    started_ = true;
+    deadline_ = now + period_;
+    return;
+  }
+
+  if (deadline_ - now > kSpinTime) {
+    std::this_thread::sleep_until(deadline_ - kSpinTime);
+  }
+  while (Clock::now() < deadline_) {
+  }
+  deadline_ += period_;
+}
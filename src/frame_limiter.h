@@ -0,0 +1,38 @@
+// Caps the frame rate of the render loop on the CPU. Each frame waits until
+// its deadline: it sleeps for most of the remaining time, since a sleep can
+// overshoot by the scheduler's granularity, then spins on the clock for the
+// last stretch to release the frame on time.
+//
+// Deadlines advance by a fixed period, so a late frame is made up for by the
+// next one instead of shifting every later frame. A loop that falls behind by
+// more than a period starts over from the current time.
+
+#ifndef FRAME_LIMITER_H_
+#define FRAME_LIMITER_H_
+
+#include <chrono>
+
+class FrameLimiter {
+ public:
+  FrameLimiter();
+
+  // Limits the loop to max_fps frames per second; 0 removes the limit.
+  void SetMaxFps(double max_fps);
+
+  bool IsEnabled() const { return period_.count() > 0; }
+
+  // Blocks until the next frame may start.
+  void Wait();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  FrameLimiter(const FrameLimiter&);
+  FrameLimiter& operator=(const FrameLimiter&);
+
+  Clock::duration period_;
+  Clock::time_point deadline_;
+  bool started_;
+};
+
+#endif  // FRAME_LIMITER_H_
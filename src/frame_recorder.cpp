@@ -0,0 +1,221 @@
+#include "frame_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram() { Clear(); }
+
+void LatencyHistogram::Clear() {
+  memset(buckets_, 0, sizeof(buckets_));
+  count_ = 0;
+  max_ = 0;
+}
+
+int LatencyHistogram::BucketIndex(uint64_t us) {
+  if (us < kLinearBuckets) {
+    return static_cast<int>(us);
+  }
+
+  // Shift the value down until it lands in [kSubBuckets, 2 * kSubBuckets).
+  int shift = 0;
+  while ((us >> shift) >= 2 * kSubBuckets) {
+    ++shift;
+  }
+  if (shift > kMaxShift) {
+    return kBuckets - 1;
+  }
+  int sub = static_cast<int>(us >> shift) - kSubBuckets;
+  return kLinearBuckets + (shift - 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketValue(int index) {
+  if (index < kLinearBuckets) {
+    return index;
+  }
+  int shift = (index - kLinearBuckets) / kSubBuckets + 1;
+  uint64_t sub = (index - kLinearBuckets) % kSubBuckets + kSubBuckets;
+
+  // Report the middle of the bucket.
+  return (sub << shift) + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::Add(uint64_t us) {
+  ++buckets_[BucketIndex(us)];
+  ++count_;
+  max_ = std::max(max_, us);
+}
+
+uint64_t LatencyHistogram::Percentile(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * count_));
+  target = std::max<uint64_t>(target, 1);
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= target) {
+      return std::min(BucketValue(i), max_);
+    }
+  }
+  return max_;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+FrameRecorder::FrameRecorder()
+    : n_frames_(0),
+      n_interval_frames_(0),
+      reporting_(false),
+      current_allocations_(0),
+      counting_allocations_(false) {
+  memset(ring_, 0, sizeof(ring_));
+  memset(current_, 0, sizeof(current_));
+  memset(&interval_allocations_, 0, sizeof(interval_allocations_));
+  memset(&total_allocations_, 0, sizeof(total_allocations_));
+}
+
+FrameRecorder::~FrameRecorder() {
+  if (log_.is_open()) {
+    log_.close();
+  }
+}
+
+bool FrameRecorder::OpenLog(const std::string& path) {
+  log_.open(path.c_str(), std::ios::out | std::ios::app);
+  if (!log_.is_open()) {
+    fprintf(stderr, "Frame recorder: could not open \"%s\"\n", path.c_str());
+    return false;
+  }
+  reporting_ = true;
+  return true;
+}
+
+void FrameRecorder::EndFrame() {
+  FrameSample& sample = ring_[n_frames_ % FRAME_RECORDER_RING];
+  for (int metric = 0; metric < N_METRICS; ++metric) {
+    sample.ms[metric] = current_[metric];
+    interval_[metric].Add(static_cast<uint64_t>(current_[metric] * 1000.0));
+    current_[metric] = 0.0;
+  }
+  interval_allocations_.sum += current_allocations_;
+  interval_allocations_.max =
+      std::max(interval_allocations_.max, current_allocations_);
+  current_allocations_ = 0;
+  ++n_frames_;
+  ++n_interval_frames_;
+
+  if (n_interval_frames_ >= FRAME_RECORDER_REPORT_INTERVAL) {
+    if (reporting_) {
+      Report(false);
+    }
+    for (int metric = 0; metric < N_METRICS; ++metric) {
+      total_[metric].Merge(interval_[metric]);
+      interval_[metric].Clear();
+    }
+    total_allocations_.sum += interval_allocations_.sum;
+    total_allocations_.max =
+        std::max(total_allocations_.max, interval_allocations_.max);
+    memset(&interval_allocations_, 0, sizeof(interval_allocations_));
+    n_interval_frames_ = 0;
+  }
+}
+
+void FrameRecorder::Report(bool summary) {
+  LatencyHistogram merged[N_METRICS];
+  const LatencyHistogram* source = interval_;
+  uint64_t n_frames = n_interval_frames_;
+  AllocationStats allocations = interval_allocations_;
+  if (summary) {
+    for (int metric = 0; metric < N_METRICS; ++metric) {
+      merged[metric] = total_[metric];
+      merged[metric].Merge(interval_[metric]);
+    }
+    source = merged;
+    n_frames = n_frames_;
+    allocations.sum += total_allocations_.sum;
+    allocations.max = std::max(allocations.max, total_allocations_.max);
+  }
+  if (n_frames == 0) {
+    return;
+  }
+
+  printf("%s over %llu frames (ms):\n",
+         summary ? "Frame time summary" : "Frame times",
+         static_cast<unsigned long long>(n_frames));
+  for (int metric = 0; metric < N_METRICS; ++metric) {
+    const LatencyHistogram& h = source[metric];
+    printf("  %-8s p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+           GetMetricName(static_cast<Metric>(metric)),
+           h.Percentile(50) / 1000.0, h.Percentile(90) / 1000.0,
+           h.Percentile(99) / 1000.0, h.Max() / 1000.0);
+  }
+  if (counting_allocations_) {
+    printf("  allocations per frame: mean %.2f  max %llu\n",
+           static_cast<double>(allocations.sum) / n_frames,
+           static_cast<unsigned long long>(allocations.max));
+  }
+
+  if (log_.is_open()) {
+    log_ << "{\"kind\":\"" << (summary ? "summary" : "interval")
+         << "\",\"frames\":" << n_frames << ",\"end_frame\":" << n_frames_;
+    for (int metric = 0; metric < N_METRICS; ++metric) {
+      const LatencyHistogram& h = source[metric];
+      log_ << ",\"" << GetMetricName(static_cast<Metric>(metric))
+           << "_ms\":{\"p50\":" << h.Percentile(50) / 1000.0
+           << ",\"p90\":" << h.Percentile(90) / 1000.0
+           << ",\"p99\":" << h.Percentile(99) / 1000.0
+           << ",\"max\":" << h.Max() / 1000.0 << "}";
+    }
+    if (counting_allocations_) {
+      log_ << ",\"allocations\":{\"mean\":"
+           << static_cast<double>(allocations.sum) / n_frames
+           << ",\"max\":" << allocations.max << "}";
+    }
+    log_ << "}\n";
+    log_.flush();
+  }
+}
+
+double FrameRecorder::RecentAverage(Metric metric) const {
+  uint64_t n = std::min<uint64_t>(n_frames_, FRAME_RECORDER_RING);
+  if (n == 0) {
+    return 0.0;
+  }
+  double total = 0.0;
+  for (uint64_t i = 0; i < n; ++i) {
+    total += ring_[i].ms[metric];
+  }
+  return total / n;
+}
+
+double FrameRecorder::Last(Metric metric) const {
+  if (n_frames_ == 0) {
+    return 0.0;
+  }
+  return ring_[(n_frames_ - 1) % FRAME_RECORDER_RING].ms[metric];
+}
+
+const char* FrameRecorder::GetMetricName(Metric metric) {
+  switch (metric) {
+    case METRIC_FRAME:
+      return "frame";
+    case METRIC_ACQUIRE:
+      return "acquire";
+    case METRIC_SUBMIT:
+      return "submit";
+    case METRIC_PRESENT:
+      return "present";
+    default:
+      return "unknown";
+  }
+}
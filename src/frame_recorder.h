@@ -0,0 +1,124 @@
+// In-process frame-time telemetry. Every frame's CPU frame time, swapchain
+// acquire wait, queue submit and present durations are kept in a fixed-size
+// ring and accumulated into log-linear (HDR-style) histograms, so percentiles
+// can be reported without allocating or printing anything per frame.
+
+#ifndef FRAME_RECORDER_H_
+#define FRAME_RECORDER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#define FRAME_RECORDER_RING 1024
+#define FRAME_RECORDER_REPORT_INTERVAL 600
+
+// Histogram of microsecond values. Values below 64us are counted exactly;
+// above that every power of two is split into 32 linear buckets, which keeps
+// the relative error of any reported percentile under ~3%.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Add(uint64_t us);
+  void Clear();
+
+  uint64_t Count() const { return count_; }
+  uint64_t Max() const { return max_; }
+
+  // Value at percentile p in [0, 100], in microseconds.
+  uint64_t Percentile(double p) const;
+
+  // Adds all samples of another histogram.
+  void Merge(const LatencyHistogram& other);
+
+ private:
+  static const int kLinearBuckets = 64;
+  static const int kSubBuckets = 32;
+  static const int kMaxShift = 36;
+  static const int kBuckets = kLinearBuckets + kMaxShift * kSubBuckets;
+
+  static int BucketIndex(uint64_t us);
+  static uint64_t BucketValue(int index);
+
+  uint32_t buckets_[kBuckets];
+  uint64_t count_;
+  uint64_t max_;
+};
+
+class FrameRecorder {
+ public:
+  enum Metric {
+    METRIC_FRAME = 0,
+    METRIC_ACQUIRE,
+    METRIC_SUBMIT,
+    METRIC_PRESENT,
+    N_METRICS
+  };
+
+  FrameRecorder();
+  ~FrameRecorder();
+
+  // Periodic reports are printed every FRAME_RECORDER_REPORT_INTERVAL frames
+  // once enabled. A summary is always available through Report(true).
+  void SetReporting(bool enabled) { reporting_ = enabled; }
+
+  // Appends every report as a JSON line to the given file.
+  bool OpenLog(const std::string& path);
+
+  // Records a duration for the frame currently being built.
+  void Record(Metric metric, double ms) { current_[metric] = ms; }
+
+  // Records the heap allocations of the frame currently being built, which
+  // are reported with the frame times once any frame has recorded them.
+  void RecordAllocations(uint64_t n) {
+    current_allocations_ = n;
+    counting_allocations_ = true;
+  }
+
+  // Commits the current frame to the ring and histograms, and prints the
+  // periodic report if one is due.
+  void EndFrame();
+
+  // Prints p50/p90/p99/max of every metric, either over the frames since the
+  // last report or over the whole run.
+  void Report(bool summary);
+
+  uint64_t GetFrameCount() const { return n_frames_; }
+
+  // Average of a metric over the frames still held in the ring.
+  double RecentAverage(Metric metric) const;
+
+  // Last committed value of a metric, in milliseconds.
+  double Last(Metric metric) const;
+
+  static const char* GetMetricName(Metric metric);
+
+ private:
+  struct FrameSample {
+    double ms[N_METRICS];
+  };
+
+  FrameSample ring_[FRAME_RECORDER_RING];
+  double current_[N_METRICS];
+  uint64_t n_frames_;
+  uint64_t n_interval_frames_;
+  bool reporting_;
+
+  LatencyHistogram interval_[N_METRICS];
+  LatencyHistogram total_[N_METRICS];
+
+  // Heap allocations per frame, summed and maxed like the histograms.
+  struct AllocationStats {
+    uint64_t sum;
+    uint64_t max;
+  };
+  uint64_t current_allocations_;
+  bool counting_allocations_;
+  AllocationStats interval_allocations_;
+  AllocationStats total_allocations_;
+
+  std::ofstream log_;
+};
+
+#endif  // FRAME_RECORDER_H_
@@ -0,0 +1,69 @@
+#include "input_latency.h"
+
+#include <cstdio>
+#include <cstring>
+
+InputLatency::InputLatency()
+    : enabled_(false), n_pending_(0), n_inputs_(0), n_untimed_(0) {}
+
+uint64_t InputLatency::OnInput() {
+  const uint64_t ordinal = n_inputs_++;
+  if (!enabled_) {
+    return ordinal;
+  }
+  if (n_pending_ == kMaxPending) {
+    ++n_untimed_;
+    return ordinal;
+  }
+  pending_[n_pending_].ordinal = ordinal;
+  pending_[n_pending_].time = Clock::now();
+  ++n_pending_;
+  return ordinal;
+}
+
+void InputLatency::OnPresent(uint64_t n_inputs_applied) {
+  // Pending events are in ordinal order.
+  int n_presented = 0;
+  while (n_presented < n_pending_ &&
+         pending_[n_presented].ordinal < n_inputs_applied) {
+    ++n_presented;
+  }
+  if (n_presented == 0) {
+    return;
+  }
+  const Clock::time_point now = Clock::now();
+  for (int n_event = 0; n_event < n_presented; ++n_event) {
+    interval_.Add(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - pending_[n_event].time)
+            .count()));
+  }
+  n_pending_ -= n_presented;
+  memmove(pending_, pending_ + n_presented, n_pending_ * sizeof(pending_[0]));
+}
+
+void InputLatency::Report(bool summary) {
+  LatencyHistogram merged;
+  const LatencyHistogram* source = &interval_;
+  if (summary) {
+    merged = total_;
+    merged.Merge(interval_);
+    source = &merged;
+  }
+  if (source->Count() > 0) {
+    printf(
+        "%s over %llu events (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+        summary ? "Input latency summary" : "Input latency",
+        static_cast<unsigned long long>(source->Count()),
+        source->Percentile(50) / 1000.0, source->Percentile(90) / 1000.0,
+        source->Percentile(99) / 1000.0, source->Max() / 1000.0);
+    if (summary && n_untimed_ > 0) {
+      printf("  %llu events arrived past the per-frame limit untimed\n",
+             static_cast<unsigned long long>(n_untimed_));
+    }
+  }
+  if (!summary) {
+    total_.Merge(interval_);
+    interval_.Clear();
+  }
+}
@@ -0,0 +1,64 @@
+// Input-to-present latency. Every camera input event is numbered and
+// timestamped as the GLFW callbacks receive it. The simulation reports how
+// many inputs the view it hands out fully reflects, which are those of the
+// older of the two ticks it blends until the blend reaches the newer one, so
+// when the present call of the first frame fully showing a tick returns, the
+// time since each event that tick applied is added to a histogram and
+// reported as percentiles.
+//
+// The present call only queues the image, so the time until it reaches the
+// display (up to a refresh interval in FIFO mode, plus the display's own
+// latency) is not included.
+
+#ifndef INPUT_LATENCY_H_
+#define INPUT_LATENCY_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "frame_recorder.h"
+
+class InputLatency {
+ public:
+  InputLatency();
+
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  bool IsEnabled() const { return enabled_; }
+
+  // Timestamps an input event and returns its ordinal, counting from 0.
+  uint64_t OnInput();
+
+  // Records the latency of every event with an ordinal below
+  // n_inputs_applied, which the frame just presented reflects.
+  void OnPresent(uint64_t n_inputs_applied);
+
+  // Prints p50/p90/p99/max latency, either over the events since the last
+  // report or over the whole run.
+  void Report(bool summary);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  // Events past this many waiting for a frame, such as a burst of mouse
+  // moves, are counted as untimed rather than stored.
+  static const int kMaxPending = 256;
+
+  struct PendingInput {
+    uint64_t ordinal;
+    Clock::time_point time;
+  };
+
+  InputLatency(const InputLatency&);
+  InputLatency& operator=(const InputLatency&);
+
+  bool enabled_;
+  PendingInput pending_[kMaxPending];
+  int n_pending_;
+  uint64_t n_inputs_;
+  uint64_t n_untimed_;
+
+  LatencyHistogram interval_;
+  LatencyHistogram total_;
+};
+
+#endif  // INPUT_LATENCY_H_
@@ -0,0 +1,256 @@
+// Flat open-addressing hash set and map keyed by 4D integer coordinates.
+//
+// All slots live in one array, probed linearly from the key's home slot, so
+// a lookup reads a few neighbouring cache lines instead of chasing bucket
+// nodes. A separate array of one control byte per slot holds 0 for an empty
+// slot or a 7-bit tag of the key's hash, so most probes reject a slot from
+// the control byte alone; the bytes are contiguous for group scanning with
+// SIMD compares. Erasing shifts the following slots of the probe run back
+// instead of leaving tombstones, so lookups never slow down with churn.
+//
+// Keys are mixed with a 64-bit finalizer, which spreads the small, dense
+// coordinates of a scene evenly over the table.
+
+#ifndef IVEC4_HASH_H_
+#define IVEC4_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+inline uint64_t HashIvec4(const glm::ivec4& key) {
+  uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(key.x)) |
+                static_cast<uint64_t>(static_cast<uint32_t>(key.y)) << 32) *
+               0x9e3779b97f4a7c15ull;
+  h ^= (static_cast<uint64_t>(static_cast<uint32_t>(key.z)) |
+        static_cast<uint64_t>(static_cast<uint32_t>(key.w)) << 32) *
+       0xc2b2ae3d27d4eb4full;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+// The shared table. Slot is a struct with a glm::ivec4 member named key.
+template <typename Slot>
+class FlatIvec4Table {
+ public:
+  FlatIvec4Table() : size_(0), mask_(0) {}
+
+  size_t Size() const { return size_; }
+  bool IsEmpty() const { return size_ == 0; }
+
+  void Clear() {
+    control_.assign(control_.size(), static_cast<uint8_t>(kEmpty));
+    size_ = 0;
+  }
+
+  // Grows the table so that n keys fit without another rehash.
+  void Reserve(size_t n) {
+    size_t capacity = kMinCapacity;
+    while (capacity * kMaxLoadNum < n * kMaxLoadDen) {
+      capacity *= 2;
+    }
+    if (capacity > control_.size()) {
+      Rehash(capacity);
+    }
+  }
+
+  const Slot* Find(const glm::ivec4& key) const {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    const uint64_t hash = HashIvec4(key);
+    const uint8_t tag = GetTag(hash);
+    for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+      if (control_[i] == tag && slots_[i].key == key) {
+        return &slots_[i];
+      }
+      if (control_[i] == kEmpty) {
+        return nullptr;
+      }
+    }
+  }
+
+  Slot* Find(const glm::ivec4& key) {
+    return const_cast<Slot*>(
+        static_cast<const FlatIvec4Table*>(this)->Find(key));
+  }
+
+  // Returns the slot of key, and whether it was added. A new slot holds a
+  // default-constructed Slot apart from its key.
+  std::pair<Slot*, bool> Insert(const glm::ivec4& key) {
+    if ((size_ + 1) * kMaxLoadDen > control_.size() * kMaxLoadNum) {
+      Reserve(size_ + 1);
+    }
+    const uint64_t hash = HashIvec4(key);
+    const uint8_t tag = GetTag(hash);
+    size_t i = hash & mask_;
+    for (;; i = (i + 1) & mask_) {
+      if (control_[i] == tag && slots_[i].key == key) {
+        return std::make_pair(&slots_[i], false);
+      }
+      if (control_[i] == kEmpty) {
+        break;
+      }
+    }
+    control_[i] = tag;
+    slots_[i] = Slot();
+    slots_[i].key = key;
+    ++size_;
+    return std::make_pair(&slots_[i], true);
+  }
+
+  bool Erase(const glm::ivec4& key) {
+    Slot* slot = Find(key);
+    if (slot == nullptr) {
+      return false;
+    }
+    size_t hole = slot - slots_.data();
+    for (size_t i = (hole + 1) & mask_; control_[i] != kEmpty;
+         i = (i + 1) & mask_) {
+      // Move the slot back into the hole unless its home lies after the
+      // hole, where a lookup would no longer pass the hole to reach it.
+      const size_t home = HashIvec4(slots_[i].key) & mask_;
+      if (((i - home) & mask_) >= ((i - hole) & mask_)) {
+        control_[hole] = control_[i];
+        slots_[hole] = slots_[i];
+        hole = i;
+      }
+    }
+    control_[hole] = kEmpty;
+    --size_;
+    return true;
+  }
+
+  // Calls f(slot) for every occupied slot, in table order.
+  template <typename F>
+  void ForEach(F f) const {
+    for (size_t i = 0; i < control_.size(); ++i) {
+      if (control_[i] != kEmpty) {
+        f(slots_[i]);
+      }
+    }
+  }
+
+ private:
+  static const uint8_t kEmpty = 0;
+  static const size_t kMinCapacity = 16;
+
+  // Linear probing stays short up to about 3/4 full.
+  static const size_t kMaxLoadNum = 3;
+  static const size_t kMaxLoadDen = 4;
+
+  static uint8_t GetTag(uint64_t hash) {
+    return static_cast<uint8_t>(0x80 | (hash >> 57));
+  }
+
+  void Rehash(size_t capacity) {
+    std::vector<uint8_t> old_control(capacity, static_cast<uint8_t>(kEmpty));
+    std::vector<Slot> old_slots(capacity);
+    old_control.swap(control_);
+    old_slots.swap(slots_);
+    mask_ = capacity - 1;
+    for (size_t n = 0; n < old_control.size(); ++n) {
+      if (old_control[n] == kEmpty) {
+        continue;
+      }
+      size_t i = HashIvec4(old_slots[n].key) & mask_;
+      while (control_[i] != kEmpty) {
+        i = (i + 1) & mask_;
+      }
+      control_[i] = old_control[n];
+      slots_[i] = old_slots[n];
+    }
+  }
+
+  std::vector<uint8_t> control_;
+  std::vector<Slot> slots_;
+  size_t size_;
+  size_t mask_;
+};
+
+class FlatIvec4Set {
+ public:
+  size_t Size() const { return table_.Size(); }
+  void Clear() { table_.Clear(); }
+  void Reserve(size_t n) { table_.Reserve(n); }
+
+  bool Contains(const glm::ivec4& key) const {
+    return table_.Find(key) != nullptr;
+  }
+
+  // Returns true if key was not in the set yet.
+  bool Insert(const glm::ivec4& key) { return table_.Insert(key).second; }
+
+  // Returns true if key was in the set.
+  bool Erase(const glm::ivec4& key) { return table_.Erase(key); }
+
+  // Calls f(key) for every key, in no particular order.
+  template <typename F>
+  void ForEach(F f) const {
+    table_.ForEach([&f](const Slot& slot) { f(slot.key); });
+  }
+
+ private:
+  struct Slot {
+    glm::ivec4 key;
+  };
+  FlatIvec4Table<Slot> table_;
+};
+
+// Values must be default-constructible and cheap to copy, since the table
+// moves them when it grows or erases. Pointers to values stay valid until
+// the next Insert() or Erase().
+template <typename Value>
+class FlatIvec4Map {
+ public:
+  size_t Size() const { return table_.Size(); }
+  void Clear() { table_.Clear(); }
+  void Reserve(size_t n) { table_.Reserve(n); }
+
+  bool Contains(const glm::ivec4& key) const {
+    return table_.Find(key) != nullptr;
+  }
+
+  // Returns the value of key, or nullptr if there is none.
+  const Value* Find(const glm::ivec4& key) const {
+    const Slot* slot = table_.Find(key);
+    return slot != nullptr ? &slot->value : nullptr;
+  }
+  Value* Find(const glm::ivec4& key) {
+    Slot* slot = table_.Find(key);
+    return slot != nullptr ? &slot->value : nullptr;
+  }
+
+  // Sets the value of key. Returns true if key was not in the map yet.
+  bool Insert(const glm::ivec4& key, const Value& value) {
+    std::pair<Slot*, bool> result = table_.Insert(key);
+    result.first->value = value;
+    return result.second;
+  }
+
+  // Returns true if key was in the map.
+  bool Erase(const glm::ivec4& key) { return table_.Erase(key); }
+
+  // Calls f(key, value) for every entry, in no particular order.
+  template <typename F>
+  void ForEach(F f) const {
+    table_.ForEach([&f](const Slot& slot) { f(slot.key, slot.value); });
+  }
+
+ private:
+  struct Slot {
+    Slot() : key(0), value() {}
+    glm::ivec4 key;
+    Value value;
+  };
+  FlatIvec4Table<Slot> table_;
+};
+
+#endif  // IVEC4_HASH_H_
@@ -6,21 +6,124 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include <streambuf>
+#include <utility>
 #include <sstream>
+// Before matrix.h, whose Anvil headers define nullptr as NULL on Linux.
+#include <thread>
 #include "matrix.h"
 #include "app.h"
 #include "terrain.h"
 #include "perlin.h"
+#include "scene_loader.h"
+#include "startup_timer.h"
 
 using namespace std;
 
+// Pull "--name[=value]" switches out of the argument list into the options,
+// leaving the positional arguments in their documented order.
+static std::vector<char*> ParseOptions(int argc, char* argv[],
+	AppOptions* options) {
+	std::vector<char*> positional;
+	for (int i = 0; i < argc; ++i) {
+		if (i == 0 || strncmp(argv[i], "--", 2) != 0) {
+			positional.push_back(argv[i]);
+			continue;
+		}
+		std::string name(argv[i] + 2);
+		std::string value;
+		size_t split = name.find('=');
+		if (split != std::string::npos) {
+			value = name.substr(split + 1);
+			name = name.substr(0, split);
+		}
+
+		if (name == "gpu-profile") {
+			options->gpu_profile = true;
+			options->gpu_profile_log = value;
+		} else if (name == "pipeline-stats") {
+			options->pipeline_stats = true;
+		} else if (name == "shader-counters") {
+			options->shader_counters = true;
+		} else if (name == "headless") {
+			options->headless = true;
+			if (!value.empty()) {
+				options->headless_frames = atoi(value.c_str());
+			}
+		} else if (name == "snapshots") {
+			options->snapshots = true;
+			if (!value.empty()) {
+				options->snapshot_prefix = value;
+			}
+		} else if (name == "camera-path") {
+			options->camera_path = value;
+		} else if (name == "record-path") {
+			options->record_path = value;
+		} else if (name == "wireframe") {
+			options->wireframe = true;
+		} else if (name == "startup-csv") {
+			options->startup_csv = value;
+		} else if (name == "watch") {
+			options->watch_scene = true;
+		} else if (name == "frame-stats") {
+			options->frame_stats = true;
+			options->frame_stats_log = value;
+		} else if (name == "present-mode") {
+			if (value == "fifo") {
+				options->present_mode = VK_PRESENT_MODE_FIFO_KHR;
+			} else if (value == "mailbox") {
+				options->present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+			} else if (value == "immediate") {
+				options->present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			} else {
+				cout << "Ignoring unknown present mode \"" << value << "\"\n";
+			}
+		} else if (name == "frames-in-flight") {
+			options->frames_in_flight = atoi(value.c_str());
+		} else if (name == "max-fps") {
+			options->max_fps = atof(value.c_str());
+		} else if (name == "input-latency") {
+			options->input_latency = true;
+		} else {
+			cout << "Ignoring unknown option \"" << argv[i] << "\"\n";
+		}
+	}
+	return positional;
+}
+
 // Main entry-point of the visualizer.
 int main(int argc, char* argv[]) {
+	// Start the startup clock before anything else happens.
+	StartupTimer* startup_timer = StartupTimer::GetInstance();
+
+	AppOptions options;
+	std::vector<char*> args = ParseOptions(argc, argv, &options);
+	argc = static_cast<int>(args.size());
+	argv = args.data();
 
 	if (argc < 4) {
 		cout << "Use: " << argv[0] 
-			 << " <Width> <Height> <Scene File | PERLIN | OPENSIMPLEX> [persistence] [frequency] [x size] [y size] [z size] [w size]\n";
+			 << " <Width> <Height> <Scene File | PERLIN | OPENSIMPLEX> [persistence] [frequency] [x size] [y size] [z size] [w size]\n"
+			 << "Options:\n"
+			 << "  --gpu-profile[=<csv file>]  Time the GPU passes, optionally logging every frame.\n"
+			 << "  --pipeline-stats            Query vertex, geometry shader and clipping statistics.\n"
+			 << "  --shader-counters           Count processed blocks and emitted/culled primitives in the shaders.\n"
+			 << "  --frame-stats[=<json file>] Report frame time percentiles, optionally as JSON lines.\n"
+			 << "  --headless[=<frames>]       Render offscreen for a number of frames (default 1000).\n"
+			 << "  --snapshots[=<prefix>]      With --headless, store every frame as <prefix>_<n>.png.\n"
+			 << "  --camera-path=<file>        Replay a scripted camera path and report frame times.\n"
+			 << "  --record-path=<file>        Save this session's camera movement as a path on exit.\n"
+			 << "  --wireframe                 Start in the wireframe render mode.\n"
+			 << "  --startup-csv=<file>        Append this run's startup phase times as a CSV row.\n"
+			 << "  --watch                     Reload the scene file whenever it changes.\n"
+			 << "  --present-mode=<mode>       Present with fifo (default), mailbox or immediate.\n"
+			 << "  --frames-in-flight=<n>      Frames the CPU may run ahead of the GPU (1-3, default 2).\n"
+			 << "  --max-fps=<fps>             Limit the frame rate in a window.\n"
+			 << "  --input-latency             Report the latency from input events to present.\n";
 	} else {
 
 		// Retrieve the window dimensions.
@@ -60,12 +163,16 @@ int main(int argc, char* argv[]) {
 				wSize = atoi(argv[9]);
 			}
 
-			// Generate the terrain.
-			Terrain::Chunk c(glm::ivec4(xSize, ySize, wSize, zSize), persistence, frequency, 0);
-			std::vector<Terrain::Block*> blocks = c.GetAllBlocks();
+			// Generate the terrain in the background while the app starts.
+			startup_timer->SetScene("PERLIN_" + std::to_string(xSize) + "x" +
+				std::to_string(ySize) + "x" + std::to_string(zSize) + "x" +
+				std::to_string(wSize));
+			std::unique_ptr<SceneLoader> loader = SceneLoader::FromTerrain(
+				glm::ivec4(xSize, ySize, wSize, zSize), persistence, frequency, 0);
 
 			// Initialize the app.
-			std::shared_ptr<App> app_ptr(new App(width, height, blocks));
+			std::shared_ptr<App> app_ptr(new App(width, height, std::move(loader),
+				options));
 			app_ptr->init();
 			printf("Initialized. Running...\n");
 
@@ -103,12 +210,16 @@ int main(int argc, char* argv[]) {
 				wSize = atoi(argv[9]);
 			}
 
-			// Generate the terrain.
-			Terrain::Chunk c(glm::ivec4(xSize, ySize, wSize, zSize), persistence, frequency, 1);
-			std::vector<Terrain::Block*> blocks = c.GetAllBlocks();
+			// Generate the terrain in the background while the app starts.
+			startup_timer->SetScene("OPENSIMPLEX_" + std::to_string(xSize) + "x" +
+				std::to_string(ySize) + "x" + std::to_string(zSize) + "x" +
+				std::to_string(wSize));
+			std::unique_ptr<SceneLoader> loader = SceneLoader::FromTerrain(
+				glm::ivec4(xSize, ySize, wSize, zSize), persistence, frequency, 1);
 
 			// Initialize the app.
-			std::shared_ptr<App> app_ptr(new App(width, height, blocks));
+			std::shared_ptr<App> app_ptr(new App(width, height, std::move(loader),
+				options));
 			app_ptr->init();
 			printf("Initialized. Running...\n");
 
@@ -117,28 +228,22 @@ int main(int argc, char* argv[]) {
 			printf("Run function completed.\n");
 		} else {
 
-			// The user specified a file to read existing data from.
-			ifstream meshData(scene);
-			if (!meshData.is_open()) {
-				cout << "Could not read \"" << scene << "\"\n";
-			}  else {
-				
-				// Parse the terrain.
-				std::vector<Terrain::Block*> blocks;
-				int x, y, z, w;
-				while (meshData >> x >> y >> w >> z) {
-					blocks.push_back(new Terrain::Block(glm::ivec4(x, y, z, w), 1));
-				}
-
-				// Initialize the app.
-				std::shared_ptr<App> app_ptr(new App(width, height, blocks));
-				app_ptr->init();
-				printf("Initialized. Running...\n");
-
-				// Run the app.
-				app_ptr->run();
-				printf("Run function completed.\n");
+			// The user specified a file to read existing data from. The app
+			// streams it into GPU memory while parsing it, and renders the
+			// blocks loaded so far in the meantime.
+			startup_timer->SetScene(scene);
+			std::unique_ptr<SceneLoader> loader = SceneLoader::FromFile(scene);
+			if (!loader) {
+				return 1;
 			}
+			std::shared_ptr<App> app_ptr(new App(width, height, std::move(loader),
+				options));
+			app_ptr->init();
+			printf("Initialized. Running...\n");
+
+			// Run the app.
+			app_ptr->run();
+			printf("Run function completed.\n");
 		}
 	}
 	return 0;
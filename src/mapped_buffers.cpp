@@ -0,0 +1,41 @@
+#include "mapped_buffers.h"
+
+#include <cstdio>
+
+#include "wrappers/memory_block.h"
+
+MappedBuffers::MappedBuffers() : device_(VK_NULL_HANDLE) {}
+
+MappedBuffers::~MappedBuffers() { Clear(); }
+
+void MappedBuffers::Init(std::weak_ptr<Anvil::SGPUDevice> device) {
+  device_ = device.lock()->get_device_vk();
+}
+
+unsigned char* MappedBuffers::Map(
+    const std::shared_ptr<Anvil::Buffer>& buffer) {
+  std::shared_ptr<Anvil::MemoryBlock> block = buffer->get_memory_block(0);
+  VkDeviceMemory memory = block->get_memory();
+  for (const std::pair<VkDeviceMemory, unsigned char*>& mapping : mappings_) {
+    if (mapping.first == memory) {
+      return mapping.second + block->get_start_offset();
+    }
+  }
+
+  void* address = nullptr;
+  if (vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &address) !=
+      VK_SUCCESS) {
+    fprintf(stderr, "Cannot map buffer memory\n");
+    return nullptr;
+  }
+  mappings_.push_back(
+      std::make_pair(memory, static_cast<unsigned char*>(address)));
+  return mappings_.back().second + block->get_start_offset();
+}
+
+void MappedBuffers::Clear() {
+  for (const std::pair<VkDeviceMemory, unsigned char*>& mapping : mappings_) {
+    vkUnmapMemory(device_, mapping.first);
+  }
+  mappings_.clear();
+}
@@ -0,0 +1,44 @@
+// Host-visible buffers kept mapped for as long as they live, so that data
+// written every frame is a plain memcpy instead of a map, write and unmap
+// through Anvil. Buffers are suballocated, so several can share one
+// VkDeviceMemory, which is mapped once for all of them.
+//
+// A memory object may only be mapped once at a time, so the buffers mapped
+// here must come from an allocator whose memory nothing else maps.
+
+#ifndef MAPPED_BUFFERS_H_
+#define MAPPED_BUFFERS_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "wrappers/buffer.h"
+#include "wrappers/device.h"
+
+class MappedBuffers {
+ public:
+  MappedBuffers();
+
+  // Unmaps everything.
+  ~MappedBuffers();
+
+  void Init(std::weak_ptr<Anvil::SGPUDevice> device);
+
+  // Returns the host address of a baked, host-coherent buffer, mapping its
+  // memory if that is not mapped yet.
+  unsigned char* Map(const std::shared_ptr<Anvil::Buffer>& buffer);
+
+  // Unmaps everything, which must happen before the mapped buffers are
+  // released.
+  void Clear();
+
+ private:
+  MappedBuffers(const MappedBuffers&);
+  MappedBuffers& operator=(const MappedBuffers&);
+
+  VkDevice device_;
+  std::vector<std::pair<VkDeviceMemory, unsigned char*> > mappings_;
+};
+
+#endif  // MAPPED_BUFFERS_H_
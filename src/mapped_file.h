@@ -0,0 +1,34 @@
+// Read-only memory mapping of a whole file.
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Maps the file at the given path, replacing any previous mapping. Empty
+  // files open successfully with a null data pointer.
+  bool Open(const std::string& path);
+  void Close();
+
+  const char* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* data_;
+  size_t size_;
+#ifdef _WIN32
+  void* file_;
+  void* mapping_;
+#endif
+};
+
+#endif  // MAPPED_FILE_H_
@@ -4,6 +4,55 @@
 
 #include <iostream>
 
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAT5_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#ifdef MAT5_USE_SSE
+namespace {
+// The 4x4 part and the last column are stored as columns of four floats,
+// which is one SSE register each. Loads are unaligned, since a mat5 on the
+// heap is only guaranteed the alignment of a float.
+struct Columns {
+  __m128 c[5];
+};
+
+Columns LoadColumns(const glm::mat4& main_mat, const glm::vec4& column) {
+  Columns columns;
+  for (int i = 0; i < 4; ++i) {
+    columns.c[i] = _mm_loadu_ps(&main_mat[i][0]);
+  }
+  columns.c[4] = _mm_loadu_ps(&column[0]);
+  return columns;
+}
+
+template <int i>
+inline __m128 Broadcast(__m128 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i));
+}
+
+// The upper four rows of the matrix times the vector (v, e).
+inline __m128 MulColumns(const Columns& a, __m128 v, float e) {
+  __m128 result = _mm_mul_ps(a.c[0], Broadcast<0>(v));
+  result = _mm_add_ps(result, _mm_mul_ps(a.c[1], Broadcast<1>(v)));
+  result = _mm_add_ps(result, _mm_mul_ps(a.c[2], Broadcast<2>(v)));
+  result = _mm_add_ps(result, _mm_mul_ps(a.c[3], Broadcast<3>(v)));
+  return _mm_add_ps(result, _mm_mul_ps(a.c[4], _mm_set1_ps(e)));
+}
+
+// One row of the matrix, as broadcast elements, times four points (x, y, z,
+// w, 1) stored one coordinate per register.
+inline __m128 DotRow(const __m128 elements[5], const __m128 p[4]) {
+  __m128 result = _mm_add_ps(elements[4], _mm_mul_ps(elements[0], p[0]));
+  result = _mm_add_ps(result, _mm_mul_ps(elements[1], p[1]));
+  result = _mm_add_ps(result, _mm_mul_ps(elements[2], p[2]));
+  return _mm_add_ps(result, _mm_mul_ps(elements[3], p[3]));
+}
+}  // namespace
+#endif
+
 // This algorithm taken from Steven Hollasch's Master's Thesis on four-space
 // visualization.
 // It extends the cross product to four dimensions using determinants to
@@ -47,29 +96,42 @@ mat5::mat5() {
   ww = 0;
 }
 
-vec5 mat5::operator*(const vec5& other) {
+vec5 mat5::operator*(const vec5& other) const {
   vec5 result;
-  result.vec = main_mat * other.vec + column * glm::vec4(other.w);
-  result.w = glm::dot(row, glm::vec4(other.w)) + ww * other.w;
+#ifdef MAT5_USE_SSE
+  const Columns a = LoadColumns(main_mat, column);
+  _mm_storeu_ps(&result.vec[0],
+                MulColumns(a, _mm_loadu_ps(&other.vec[0]), other.w));
+#else
+  result.vec = main_mat * other.vec + column * other.w;
+#endif
+  result.w = glm::dot(row, other.vec) + ww * other.w;
   return result;
 }
 
-mat5 mat5::operator*(const mat5& other) {
+mat5 mat5::operator*(const mat5& other) const {
   mat5 result;
-  //other.Print();
-  /*result.main_mat = main_mat * other.main_mat;
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
-      result.main_mat[i][j] += column[i] * other.row[j];
-    }
-  }
+#ifdef MAT5_USE_SSE
+  const Columns a = LoadColumns(main_mat, column);
+  __m128 b[4];
   for (int i = 0; i < 4; ++i) {
-    result.column[i] =
-        glm::dot(main_mat[i], other.column) + column[i] * other.ww;
-    result.row[i] =
-        glm::dot(row, glm::column(other.main_mat, i)) + ww * other.row[i];
+    b[i] = _mm_loadu_ps(&other.main_mat[i][0]);
+    _mm_storeu_ps(&result.main_mat[i][0], MulColumns(a, b[i], other.row[i]));
   }
-  result.ww = glm::dot(row, other.column) + ww * other.ww;*/
+  _mm_storeu_ps(&result.column[0],
+                MulColumns(a, _mm_loadu_ps(&other.column[0]), other.ww));
+
+  // The last row is row times the columns of other, which after a
+  // transpose are its rows.
+  _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+  const __m128 r = _mm_loadu_ps(&row[0]);
+  __m128 last = _mm_mul_ps(_mm_loadu_ps(&other.row[0]), _mm_set1_ps(ww));
+  last = _mm_add_ps(last, _mm_mul_ps(Broadcast<0>(r), b[0]));
+  last = _mm_add_ps(last, _mm_mul_ps(Broadcast<1>(r), b[1]));
+  last = _mm_add_ps(last, _mm_mul_ps(Broadcast<2>(r), b[2]));
+  last = _mm_add_ps(last, _mm_mul_ps(Broadcast<3>(r), b[3]));
+  _mm_storeu_ps(&result.row[0], last);
+#else
   result.main_mat = main_mat * other.main_mat;
   for (int i = 0; i < 4; ++i) {
     for (int j = 0; j < 4; ++j) {
@@ -81,10 +143,57 @@ mat5 mat5::operator*(const mat5& other) {
         glm::dot(glm::row(main_mat, i), other.column) + column[i] * other.ww;
     result.row[i] = glm::dot(row, other.main_mat[i]) + ww * other.row[i];
   }
+#endif
   result.ww = glm::dot(row, other.column) + ww * other.ww;
   return result;
 }
 
+void mat5::transform(const mat5& m, const glm::vec4* points, size_t n_points,
+                     vec5* out) {
+  size_t i = 0;
+#ifdef MAT5_USE_SSE
+  // Four points at a time, transposed so that each register holds one
+  // coordinate of all four and every matrix element is a broadcast.
+  __m128 elements[5][5];
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      elements[r][c] = _mm_set1_ps(m.main_mat[c][r]);
+    }
+    elements[r][4] = _mm_set1_ps(m.column[r]);
+    elements[4][r] = _mm_set1_ps(m.row[r]);
+  }
+  elements[4][4] = _mm_set1_ps(m.ww);
+
+  for (; i + 4 <= n_points; i += 4) {
+    __m128 p[4];
+    p[0] = _mm_loadu_ps(&points[i][0]);
+    p[1] = _mm_loadu_ps(&points[i + 1][0]);
+    p[2] = _mm_loadu_ps(&points[i + 2][0]);
+    p[3] = _mm_loadu_ps(&points[i + 3][0]);
+    _MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+    __m128 q[5];
+    q[0] = DotRow(elements[0], p);
+    q[1] = DotRow(elements[1], p);
+    q[2] = DotRow(elements[2], p);
+    q[3] = DotRow(elements[3], p);
+    q[4] = DotRow(elements[4], p);
+    _MM_TRANSPOSE4_PS(q[0], q[1], q[2], q[3]);
+    _mm_storeu_ps(&out[i].vec[0], q[0]);
+    _mm_store_ss(&out[i].w, q[4]);
+    _mm_storeu_ps(&out[i + 1].vec[0], q[1]);
+    _mm_store_ss(&out[i + 1].w, Broadcast<1>(q[4]));
+    _mm_storeu_ps(&out[i + 2].vec[0], q[2]);
+    _mm_store_ss(&out[i + 2].w, Broadcast<2>(q[4]));
+    _mm_storeu_ps(&out[i + 3].vec[0], q[3]);
+    _mm_store_ss(&out[i + 3].w, Broadcast<3>(q[4]));
+  }
+#endif
+  for (; i < n_points; ++i) {
+    const glm::vec4& p = points[i];
+    out[i] = m * vec5(p.x, p.y, p.z, p.w, 1.0f);
+  }
+}
+
 mat5 mat5::perspective(float fovy, float aspectx, float aspectw,
                               float zNear, float zFar) {
   mat5 result;
@@ -163,6 +272,23 @@ mat5 mat5::translate(int axis, float amount) {
   return res;
 }
 
+mat5 mat5::rigid(const glm::mat4& rotation, const glm::vec4& translation) {
+  mat5 res;
+  res.main_mat = rotation;
+  res.column = translation;
+  res.ww = 1.0f;
+  return res;
+}
+
+mat5 mat5::lerp(const mat5& a, const mat5& b, float t) {
+  mat5 res;
+  res.main_mat = a.main_mat + (b.main_mat - a.main_mat) * t;
+  res.column = a.column + (b.column - a.column) * t;
+  res.row = a.row + (b.row - a.row) * t;
+  res.ww = a.ww + (b.ww - a.ww) * t;
+  return res;
+}
+
 void mat5::Print() const {
   std::cout << "[" << main_mat[0][0] << ", " << main_mat[1][0] << ", "
             << main_mat[2][0] << ", " << main_mat[3][0] << ", " << column[0]
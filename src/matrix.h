@@ -8,6 +8,8 @@
 #ifndef MATRIX_H_
 #define MATRIX_H_
 
+#include <cstddef>
+
 #include "glm/glm.hpp"
 
 #include "wrappers/buffer.h"
@@ -23,6 +25,13 @@ class vec5 {
 
   friend class mat5;
 
+  const glm::vec4& get_vec() const {
+    return vec;
+  }
+  const float& get_w() const {
+    return w;
+  }
+
   void Print();
 
  private:
@@ -34,9 +43,14 @@ class mat5 {
  public:
   mat5();
 
-  vec5 operator*(const vec5& other);
+  vec5 operator*(const vec5& other) const;
 
-  mat5 operator*(const mat5& other);
+  mat5 operator*(const mat5& other) const;
+
+  // Transforms n_points points (x, y, z, w, 1) by m into out, four at a
+  // time with SSE where available.
+  static void transform(const mat5& m, const glm::vec4* points,
+                        size_t n_points, vec5* out);
 
   static mat5 perspective(float fovy, float aspectx, float aspectw, float zNear,
                           float zFar);
@@ -50,6 +64,13 @@ class mat5 {
   // Gererate a translation matrix along a given axis.
   static mat5 translate(int axis, float amount);
 
+  // Generate a matrix that applies rotation, then adds translation.
+  static mat5 rigid(const glm::mat4& rotation, const glm::vec4& translation);
+
+  // Element-wise blend from a (t = 0) to b (t = 1). Only close to a rigid
+  // transform when a and b are close, such as views one step apart.
+  static mat5 lerp(const mat5& a, const mat5& b, float t);
+
   void Print() const;
 
   const glm::mat4& get_main_mat() const {
@@ -0,0 +1,121 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "wrappers/instance.h"
+#include "wrappers/physical_device.h"
+
+namespace {
+const char kMemoryBudgetExtension[] = "VK_EXT_memory_budget";
+
+// VkPhysicalDeviceMemoryBudgetPropertiesEXT, which the bundled Vulkan headers
+// predate.
+const VkStructureType kMemoryBudgetPropertiesType =
+    static_cast<VkStructureType>(1000237000);
+struct MemoryBudgetProperties {
+  VkStructureType sType;
+  void* pNext;
+  VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+};
+
+double ToMiB(VkDeviceSize bytes) {
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+}  // namespace
+
+MemoryBudget::MemoryBudget() : has_budget_(false) {
+  memset(&memory_properties_, 0, sizeof(memory_properties_));
+}
+
+void MemoryBudget::Init(std::weak_ptr<Anvil::SGPUDevice> device) {
+  std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr(device);
+  std::shared_ptr<Anvil::PhysicalDevice> physical_device_locked_ptr(
+      device_locked_ptr->get_physical_device());
+  std::shared_ptr<Anvil::Instance> instance_locked_ptr(
+      physical_device_locked_ptr->get_instance());
+  device_ = device;
+
+  vkGetPhysicalDeviceMemoryProperties(
+      physical_device_locked_ptr->get_physical_device(), &memory_properties_);
+
+  // The budget is read through vkGetPhysicalDeviceMemoryProperties2KHR, which
+  // Anvil loads whenever the instance supports it.
+  has_budget_ = instance_locked_ptr->is_instance_extension_supported(
+                    VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) &&
+                physical_device_locked_ptr->is_device_extension_supported(
+                    kMemoryBudgetExtension);
+}
+
+void MemoryBudget::Track(const std::shared_ptr<Anvil::Buffer>& buffer) {
+  blocks_.push_back(buffer->get_memory_block(0));
+}
+
+void MemoryBudget::Query(std::vector<Heap>* heaps) {
+  const uint32_t n_heaps = memory_properties_.memoryHeapCount;
+  heaps->assign(n_heaps, Heap());
+  for (uint32_t n_heap = 0; n_heap < n_heaps; ++n_heap) {
+    const VkMemoryHeap& heap = memory_properties_.memoryHeaps[n_heap];
+    (*heaps)[n_heap].size = heap.size;
+    (*heaps)[n_heap].device_local =
+        (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+  }
+
+  blocks_.erase(
+      std::remove_if(blocks_.begin(), blocks_.end(),
+                     [](const std::weak_ptr<Anvil::MemoryBlock>& block) {
+                       return block.expired();
+                     }),
+      blocks_.end());
+  for (const std::weak_ptr<Anvil::MemoryBlock>& block : blocks_) {
+    std::shared_ptr<Anvil::MemoryBlock> block_locked_ptr(block.lock());
+    if (block_locked_ptr == nullptr) {
+      continue;
+    }
+    const uint32_t type_index = block_locked_ptr->get_memory_type_index();
+    (*heaps)[memory_properties_.memoryTypes[type_index].heapIndex].app_usage +=
+        block_locked_ptr->get_size();
+  }
+
+  if (!has_budget_) {
+    return;
+  }
+  std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr(device_);
+  std::shared_ptr<Anvil::PhysicalDevice> physical_device_locked_ptr(
+      device_locked_ptr->get_physical_device());
+  std::shared_ptr<Anvil::Instance> instance_locked_ptr(
+      physical_device_locked_ptr->get_instance());
+
+  MemoryBudgetProperties budget;
+  memset(&budget, 0, sizeof(budget));
+  budget.sType = kMemoryBudgetPropertiesType;
+  VkPhysicalDeviceMemoryProperties2KHR properties;
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+  properties.pNext = &budget;
+  instance_locked_ptr->get_extension_khr_get_physical_device_properties2_entrypoints()
+      .vkGetPhysicalDeviceMemoryProperties2KHR(
+          physical_device_locked_ptr->get_physical_device(), &properties);
+  for (uint32_t n_heap = 0; n_heap < n_heaps; ++n_heap) {
+    (*heaps)[n_heap].process_usage = budget.heapUsage[n_heap];
+    (*heaps)[n_heap].budget = budget.heapBudget[n_heap];
+  }
+}
+
+void MemoryBudget::Print() {
+  std::vector<Heap> heaps;
+  Query(&heaps);
+  for (size_t n_heap = 0; n_heap < heaps.size(); ++n_heap) {
+    const Heap& heap = heaps[n_heap];
+    printf("Memory heap %zu (%s, %.0f MiB): app %.1f MiB", n_heap,
+           heap.device_local ? "device" : "host", ToMiB(heap.size),
+           ToMiB(heap.app_usage));
+    if (has_budget_) {
+      printf(", process %.1f MiB of %.1f MiB budget (%.0f%%)",
+             ToMiB(heap.process_usage), ToMiB(heap.budget),
+             heap.budget > 0 ? 100.0 * heap.process_usage / heap.budget : 0.0);
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,57 @@
+// Per-heap GPU memory usage. The memory blocks of every buffer allocated by
+// the app are tracked, so their total can be reported for each heap next to
+// the heap size and, on devices that support VK_EXT_memory_budget, the
+// process-wide usage and the budget the driver grants the process.
+
+#ifndef MEMORY_BUDGET_H_
+#define MEMORY_BUDGET_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "wrappers/buffer.h"
+#include "wrappers/device.h"
+#include "wrappers/memory_block.h"
+
+class MemoryBudget {
+ public:
+  struct Heap {
+    VkDeviceSize size;
+    bool device_local;
+
+    // Memory held by the buffers tracked here.
+    VkDeviceSize app_usage;
+
+    // Memory used by the whole process and the most it should use, from
+    // VK_EXT_memory_budget. Zero without the extension.
+    VkDeviceSize process_usage;
+    VkDeviceSize budget;
+  };
+
+  MemoryBudget();
+
+  void Init(std::weak_ptr<Anvil::SGPUDevice> device);
+
+  bool HasBudget() const { return has_budget_; }
+
+  // Counts the memory of a buffer for as long as the buffer holds it. The
+  // buffer must have been baked.
+  void Track(const std::shared_ptr<Anvil::Buffer>& buffer);
+
+  // Reads the current usage of every heap.
+  void Query(std::vector<Heap>* heaps);
+
+  // Prints one line per heap.
+  void Print();
+
+ private:
+  std::weak_ptr<Anvil::SGPUDevice> device_;
+  bool has_budget_;
+  VkPhysicalDeviceMemoryProperties memory_properties_;
+
+  // Expired blocks are dropped when the usage is next queried.
+  std::vector<std::weak_ptr<Anvil::MemoryBlock> > blocks_;
+};
+
+#endif  // MEMORY_BUDGET_H_
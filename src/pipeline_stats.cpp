@@ -0,0 +1,184 @@
+#include "pipeline_stats.h"
+
+#include <cstdio>
+
+#include "wrappers/physical_device.h"
+
+namespace {
+const VkQueryPipelineStatisticFlags kStatisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// Culled fraction, guarding against frames that produced nothing.
+double Ratio(double part, double whole) {
+  return whole > 0.0 ? 100.0 * part / whole : 0.0;
+}
+}  // namespace
+
+PipelineStats::PipelineStats() : counter_stride_(0) {}
+
+void PipelineStats::Init(std::weak_ptr<Anvil::SGPUDevice> device,
+                         uint32_t n_slots, bool use_queries,
+                         bool use_counters) {
+  std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr(device);
+  device_ = device;
+
+  if (use_queries) {
+    if (device_locked_ptr->get_physical_device_features()
+            .pipelineStatisticsQuery) {
+      query_pool_ = Anvil::QueryPool::create_ps_query_pool(
+          device, kStatisticFlags, n_slots);
+      query_pool_->set_name("Pipeline statistics");
+    } else {
+      printf("Pipeline statistics queries are not supported by this device.\n");
+    }
+  }
+
+  if (use_counters) {
+    const VkDeviceSize alignment =
+        device_locked_ptr->get_physical_device_properties()
+            .limits.minStorageBufferOffsetAlignment;
+    counter_stride_ = Anvil::Utils::round_up(GetCounterRangeSize(), alignment);
+
+    counter_buffer_ = Anvil::Buffer::create_nonsparse(
+        device, counter_stride_ * n_slots,
+        Anvil::QUEUE_FAMILY_COMPUTE_BIT | Anvil::QUEUE_FAMILY_GRAPHICS_BIT,
+        VK_SHARING_MODE_CONCURRENT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    counter_buffer_->set_name("Pipeline counters");
+  }
+
+  if (IsEnabled()) {
+    for (uint32_t slot = 0; slot < n_slots; ++slot) {
+      fences_.push_back(Anvil::Fence::create(device, false));
+    }
+    in_flight_.assign(n_slots, false);
+    results_valid_.assign(n_slots, false);
+  }
+}
+
+void PipelineStats::RecordReset(Anvil::PrimaryCommandBuffer* cmd,
+                                uint32_t slot) {
+  if (HasQueries()) {
+    cmd->record_reset_query_pool(query_pool_, slot, 1);
+  }
+  if (HasCounters()) {
+    cmd->record_fill_buffer(counter_buffer_, GetCounterOffset(slot),
+                            GetCounterRangeSize(), 0);
+
+    Anvil::BufferBarrier barrier(
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, counter_buffer_,
+        GetCounterOffset(slot), GetCounterRangeSize());
+    cmd->record_pipeline_barrier(
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT,
+        VK_FALSE, 0, nullptr, 1, &barrier, 0, nullptr);
+  }
+}
+
+void PipelineStats::RecordBegin(Anvil::PrimaryCommandBuffer* cmd,
+                                uint32_t slot) {
+  if (HasQueries()) {
+    cmd->record_begin_query(query_pool_, slot, 0);
+  }
+}
+
+void PipelineStats::RecordEnd(Anvil::PrimaryCommandBuffer* cmd,
+                              uint32_t slot) {
+  if (HasQueries()) {
+    cmd->record_end_query(query_pool_, slot);
+  }
+  if (HasCounters()) {
+    // Make the shader atomics visible to the host read in Collect().
+    Anvil::BufferBarrier barrier(
+        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, counter_buffer_,
+        GetCounterOffset(slot), GetCounterRangeSize());
+    cmd->record_pipeline_barrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_FALSE, 0, nullptr, 1, &barrier, 0,
+        nullptr);
+  }
+}
+
+VkFence PipelineStats::GetSubmitFence(uint32_t slot) {
+  if (!IsEnabled() || in_flight_[slot]) {
+    return VK_NULL_HANDLE;
+  }
+  in_flight_[slot] = true;
+  results_valid_[slot] = true;
+  return fences_[slot]->get_fence();
+}
+
+void PipelineStats::Collect(uint32_t slot) {
+  if (!IsEnabled() || !in_flight_[slot]) {
+    return;
+  }
+  if (!fences_[slot]->is_set()) {
+    // The slot is about to be resubmitted untracked, which resets its queries
+    // and counters underneath the pending submission. Drop its results.
+    results_valid_[slot] = false;
+    return;
+  }
+  fences_[slot]->reset();
+  in_flight_[slot] = false;
+  if (!results_valid_[slot]) {
+    return;
+  }
+
+  if (HasQueries()) {
+    uint64_t values[N_STATS];
+    VkResult result = vkGetQueryPoolResults(
+        device_.lock()->get_device_vk(), query_pool_->get_query_pool(), slot,
+        1, sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+      for (int stat = 0; stat < N_STATS; ++stat) {
+        stats_[stat].Add(static_cast<double>(values[stat]));
+      }
+    }
+  }
+
+  if (HasCounters()) {
+    uint32_t values[N_COUNTERS];
+    if (counter_buffer_->read(GetCounterOffset(slot), sizeof(values),
+                              values)) {
+      for (int counter = 0; counter < N_COUNTERS; ++counter) {
+        counters_[counter].Add(static_cast<double>(values[counter]));
+      }
+    }
+  }
+}
+
+void PipelineStats::Report(double frame_ms) const {
+  if (!IsEnabled()) {
+    return;
+  }
+  printf("Frame %.3f ms", frame_ms);
+  if (HasQueries() && stats_[STAT_GEOMETRY_INVOCATIONS].Count() > 0) {
+    double gs_in = stats_[STAT_GEOMETRY_INVOCATIONS].Average();
+    double gs_out = stats_[STAT_GEOMETRY_PRIMITIVES].Average();
+    printf(" | vs %.0f  gs in %.0f  gs out %.0f (%.1f%% culled)"
+           "  clip in %.0f  clip out %.0f  cs %.0f",
+           stats_[STAT_VERTEX_INVOCATIONS].Average(), gs_in, gs_out,
+           Ratio(gs_in - gs_out, gs_in),
+           stats_[STAT_CLIPPING_INVOCATIONS].Average(),
+           stats_[STAT_CLIPPING_PRIMITIVES].Average(),
+           stats_[STAT_COMPUTE_INVOCATIONS].Average());
+  }
+  if (HasCounters() && counters_[COUNTER_BLOCKS_PROCESSED].Count() > 0) {
+    double emitted = counters_[COUNTER_PRIMITIVES_EMITTED].Average();
+    double culled = counters_[COUNTER_PRIMITIVES_CULLED].Average();
+    printf(" | blocks %.0f  emitted %.0f  culled %.0f (%.1f%%)",
+           counters_[COUNTER_BLOCKS_PROCESSED].Average(), emitted, culled,
+           Ratio(culled, emitted + culled));
+  }
+  printf("\n");
+}
@@ -0,0 +1,112 @@
+// Pipeline statistics for the compute dispatch and the main render pass, used
+// to quantify how much geometry the geometry shaders cull for a given scene
+// and camera position.
+//
+// Two independent sources are supported:
+//  - Vulkan pipeline-statistics queries (vertex, geometry shader, clipping and
+//    compute invocations/primitives).
+//  - Optional atomic counters incremented by example.comp and the geometry
+//    shaders when they are built with ENABLE_PIPELINE_COUNTERS.
+// Each swapchain slot owns its own queries and counter range, tracked by a
+// fence, so results are read back a few frames later without waiting.
+
+#ifndef PIPELINE_STATS_H_
+#define PIPELINE_STATS_H_
+
+#include <memory>
+#include <vector>
+
+#include "stats.h"
+#include "wrappers/buffer.h"
+#include "wrappers/command_buffer.h"
+#include "wrappers/device.h"
+#include "wrappers/fence.h"
+#include "wrappers/query_pool.h"
+
+#define PIPELINE_STATS_WINDOW 256
+
+class PipelineStats {
+ public:
+  // Statistics in the order Vulkan returns them for the enabled flags.
+  enum Statistic {
+    STAT_VERTEX_INVOCATIONS = 0,
+    STAT_GEOMETRY_INVOCATIONS,
+    STAT_GEOMETRY_PRIMITIVES,
+    STAT_CLIPPING_INVOCATIONS,
+    STAT_CLIPPING_PRIMITIVES,
+    STAT_COMPUTE_INVOCATIONS,
+    N_STATS
+  };
+
+  // Layout of the counter block declared in the shaders.
+  enum Counter {
+    COUNTER_BLOCKS_PROCESSED = 0,
+    COUNTER_PRIMITIVES_EMITTED,
+    COUNTER_PRIMITIVES_CULLED,
+    N_COUNTERS
+  };
+
+  typedef RollingStats<PIPELINE_STATS_WINDOW> CounterStats;
+
+  PipelineStats();
+
+  // The counter buffer is created without memory; the caller allocates it
+  // host visible and coherent, since Collect() reads it back from the host.
+  void Init(std::weak_ptr<Anvil::SGPUDevice> device, uint32_t n_slots,
+            bool use_queries, bool use_counters);
+
+  bool IsEnabled() const { return HasQueries() || HasCounters(); }
+  bool HasQueries() const { return query_pool_ != nullptr; }
+  bool HasCounters() const { return counter_buffer_ != nullptr; }
+
+  // The shader counters are bound as a dynamic storage buffer; each slot
+  // binds its own range at GetCounterOffset(slot).
+  std::shared_ptr<Anvil::Buffer> GetCounterBuffer() const {
+    return counter_buffer_;
+  }
+  VkDeviceSize GetCounterRangeSize() const {
+    return sizeof(uint32_t) * N_COUNTERS;
+  }
+  uint32_t GetCounterOffset(uint32_t slot) const {
+    return static_cast<uint32_t>(slot * counter_stride_);
+  }
+
+  // Recording helpers. RecordReset must come first and outside of any render
+  // pass; RecordBegin/RecordEnd bracket the work to measure and must also be
+  // outside of render passes.
+  void RecordReset(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot);
+  void RecordBegin(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot);
+  void RecordEnd(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot);
+
+  // Returns the fence to submit the slot's command buffer with, or
+  // VK_NULL_HANDLE if the slot is still in flight and this submission cannot
+  // be tracked.
+  VkFence GetSubmitFence(uint32_t slot);
+
+  // Reads back the last tracked submission of a slot if it has finished.
+  // Never waits.
+  void Collect(uint32_t slot);
+
+  const CounterStats& GetStat(Statistic stat) const { return stats_[stat]; }
+  const CounterStats& GetCounter(Counter counter) const {
+    return counters_[counter];
+  }
+
+  // Prints average per-frame values next to the given frame time.
+  void Report(double frame_ms) const;
+
+ private:
+  std::weak_ptr<Anvil::SGPUDevice> device_;
+  std::shared_ptr<Anvil::QueryPool> query_pool_;
+  std::shared_ptr<Anvil::Buffer> counter_buffer_;
+  VkDeviceSize counter_stride_;
+
+  std::vector<std::shared_ptr<Anvil::Fence>> fences_;
+  std::vector<bool> in_flight_;
+  std::vector<bool> results_valid_;
+
+  CounterStats stats_[N_STATS];
+  CounterStats counters_[N_COUNTERS];
+};
+
+#endif  // PIPELINE_STATS_H_
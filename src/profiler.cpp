@@ -0,0 +1,153 @@
+#include "profiler.h"
+
+#include <cstdio>
+
+#include "wrappers/physical_device.h"
+#include "wrappers/queue.h"
+
+GpuProfiler::GpuProfiler()
+    : timestamp_mask_(0), ns_per_tick_(1.0), n_frames_collected_(0) {}
+
+GpuProfiler::~GpuProfiler() {
+  if (log_.is_open()) {
+    log_.close();
+  }
+}
+
+void GpuProfiler::Init(std::weak_ptr<Anvil::SGPUDevice> device,
+                       uint32_t n_slots) {
+  std::shared_ptr<Anvil::SGPUDevice> device_locked_ptr(device);
+  std::shared_ptr<Anvil::PhysicalDevice> physical_device_locked_ptr(
+      device_locked_ptr->get_physical_device());
+  const uint32_t queue_family_index =
+      device_locked_ptr->get_universal_queue(0)->get_queue_family_index();
+  const uint32_t n_valid_bits = physical_device_locked_ptr
+                                    ->get_queue_families()
+                                    .at(queue_family_index)
+                                    .n_timestamp_bits;
+
+  if (n_valid_bits == 0) {
+    printf("GPU profiler: timestamps are not supported by this queue.\n");
+    return;
+  }
+
+  device_ = device;
+  timestamp_mask_ =
+      n_valid_bits >= 64 ? ~0ull : ((1ull << n_valid_bits) - 1);
+  ns_per_tick_ = physical_device_locked_ptr->get_device_properties()
+                     .limits.timestampPeriod;
+  pending_.assign(n_slots, false);
+
+  query_pool_ = Anvil::QueryPool::create_non_ps_query_pool(
+      device, VK_QUERY_TYPE_TIMESTAMP, n_slots * N_PASSES * 2);
+  query_pool_->set_name("GPU profiler timestamps");
+}
+
+bool GpuProfiler::OpenLog(const std::string& path) {
+  log_.open(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!log_.is_open()) {
+    fprintf(stderr, "GPU profiler: could not open \"%s\"\n", path.c_str());
+    return false;
+  }
+  log_ << "frame";
+  for (int pass = 0; pass < N_PASSES; ++pass) {
+    log_ << "," << GetPassName(static_cast<Pass>(pass)) << "_ms";
+  }
+  log_ << "\n";
+  return true;
+}
+
+void GpuProfiler::RecordReset(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot) {
+  if (!IsEnabled()) {
+    return;
+  }
+  cmd->record_reset_query_pool(query_pool_, QueryIndex(slot, PASS_COMPUTE, false),
+                               N_PASSES * 2);
+}
+
+void GpuProfiler::RecordBegin(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot,
+                              Pass pass) {
+  if (!IsEnabled()) {
+    return;
+  }
+  cmd->record_write_timestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_,
+                              QueryIndex(slot, pass, false));
+}
+
+void GpuProfiler::RecordEnd(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot,
+                            Pass pass) {
+  if (!IsEnabled()) {
+    return;
+  }
+  cmd->record_write_timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                              query_pool_, QueryIndex(slot, pass, true));
+}
+
+void GpuProfiler::OnSubmit(uint32_t slot) {
+  if (IsEnabled()) {
+    pending_[slot] = true;
+  }
+}
+
+void GpuProfiler::Collect(uint32_t slot) {
+  if (!IsEnabled() || !pending_[slot]) {
+    return;
+  }
+
+  // Without VK_QUERY_RESULT_WAIT_BIT this returns VK_NOT_READY instead of
+  // blocking when the GPU is still busy with the slot; that sample is dropped.
+  uint64_t ticks[N_PASSES * 2];
+  VkResult result = vkGetQueryPoolResults(
+      device_.lock()->get_device_vk(), query_pool_->get_query_pool(),
+      QueryIndex(slot, PASS_COMPUTE, false), N_PASSES * 2, sizeof(ticks),
+      ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return;
+  }
+  pending_[slot] = false;
+
+  double ms[N_PASSES];
+  for (int pass = 0; pass < N_PASSES; ++pass) {
+    uint64_t begin = ticks[pass * 2] & timestamp_mask_;
+    uint64_t end = ticks[pass * 2 + 1] & timestamp_mask_;
+    uint64_t delta = (end - begin) & timestamp_mask_;
+    ms[pass] = delta * ns_per_tick_ * 1e-6;
+    stats_[pass].Add(ms[pass]);
+  }
+
+  if (log_.is_open()) {
+    log_ << n_frames_collected_;
+    for (int pass = 0; pass < N_PASSES; ++pass) {
+      log_ << "," << ms[pass];
+    }
+    log_ << "\n";
+  }
+  ++n_frames_collected_;
+}
+
+const char* GpuProfiler::GetPassName(Pass pass) {
+  switch (pass) {
+    case PASS_COMPUTE:
+      return "compute";
+    case PASS_MAIN:
+      return "main";
+    case PASS_AXIS:
+      return "axis";
+    default:
+      return "unknown";
+  }
+}
+
+void GpuProfiler::Report() const {
+  if (!IsEnabled()) {
+    return;
+  }
+  printf("GPU pass times over the last %u frames (ms):\n",
+         static_cast<unsigned>(stats_[PASS_COMPUTE].Count()));
+  for (int pass = 0; pass < N_PASSES; ++pass) {
+    const PassStats& s = stats_[pass];
+    printf("  %-8s avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           GetPassName(static_cast<Pass>(pass)), s.Average(),
+           s.Percentile(50), s.Percentile(95), s.Percentile(99), s.Max());
+  }
+}
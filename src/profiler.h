@@ -0,0 +1,81 @@
+// GPU timestamp profiling for the passes recorded into each per-swapchain
+// command buffer. Every command buffer owns its own slice of a timestamp query
+// pool; results are read back without waiting the next time the same
+// swapchain image comes around, so profiling never stalls the frame loop.
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stats.h"
+#include "wrappers/command_buffer.h"
+#include "wrappers/device.h"
+#include "wrappers/query_pool.h"
+
+#define GPU_PROFILER_WINDOW 256
+
+class GpuProfiler {
+ public:
+  enum Pass {
+    PASS_COMPUTE = 0,
+    PASS_MAIN,
+    PASS_AXIS,
+    N_PASSES
+  };
+
+  typedef RollingStats<GPU_PROFILER_WINDOW> PassStats;
+
+  GpuProfiler();
+  ~GpuProfiler();
+
+  // Creates the query pool with room for n_slots command buffers. Does
+  // nothing and leaves the profiler disabled if the universal queue cannot
+  // write timestamps.
+  void Init(std::weak_ptr<Anvil::SGPUDevice> device, uint32_t n_slots);
+
+  // Opens a CSV log that receives one row per frame of resolved timings.
+  bool OpenLog(const std::string& path);
+
+  bool IsEnabled() const { return query_pool_ != nullptr; }
+
+  // Recording helpers, used while building the command buffer for a slot.
+  // RecordReset must be recorded outside of any render pass, before the
+  // first timestamp of the slot.
+  void RecordReset(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot);
+  void RecordBegin(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot, Pass pass);
+  void RecordEnd(Anvil::PrimaryCommandBuffer* cmd, uint32_t slot, Pass pass);
+
+  // Marks the command buffer for a slot as submitted.
+  void OnSubmit(uint32_t slot);
+
+  // Reads back the timings of the previous submission of a slot, if the GPU
+  // has finished with it. Never waits.
+  void Collect(uint32_t slot);
+
+  const PassStats& GetPassStats(Pass pass) const { return stats_[pass]; }
+  static const char* GetPassName(Pass pass);
+
+  // Prints rolling averages and percentiles for every pass.
+  void Report() const;
+
+ private:
+  uint32_t QueryIndex(uint32_t slot, Pass pass, bool end) const {
+    return slot * N_PASSES * 2 + pass * 2 + (end ? 1 : 0);
+  }
+
+  std::weak_ptr<Anvil::SGPUDevice> device_;
+  std::shared_ptr<Anvil::QueryPool> query_pool_;
+  std::vector<bool> pending_;
+  uint64_t timestamp_mask_;
+  double ns_per_tick_;
+  uint32_t n_frames_collected_;
+
+  PassStats stats_[N_PASSES];
+  std::ofstream log_;
+};
+
+#endif  // PROFILER_H_
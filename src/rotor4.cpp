@@ -0,0 +1,152 @@
+#include "rotor4.h"
+
+#include <cmath>
+
+Rotor4::Rotor4()
+    : s_(1),
+      b01_(0),
+      b02_(0),
+      b03_(0),
+      b12_(0),
+      b13_(0),
+      b23_(0),
+      p_(0) {}
+
+Rotor4 Rotor4::FromPlane(int axis_a, int axis_b, float angle) {
+  // cos(angle / 2) - sin(angle / 2) e_a e_b, with the bivector stored under
+  // its sorted axes.
+  Rotor4 result;
+  result.s_ = std::cos(0.5f * angle);
+  float sine = -std::sin(0.5f * angle);
+  if (axis_a > axis_b) {
+    int axis = axis_a;
+    axis_a = axis_b;
+    axis_b = axis;
+    sine = -sine;
+  }
+  if (axis_a == 0) {
+    float* components[] = {&result.b01_, &result.b02_, &result.b03_};
+    *components[axis_b - 1] = sine;
+  } else if (axis_a == 1) {
+    float* components[] = {&result.b12_, &result.b13_};
+    *components[axis_b - 2] = sine;
+  } else {
+    result.b23_ = sine;
+  }
+  return result;
+}
+
+Rotor4 Rotor4::FromMatrix(const glm::mat4& rotation) {
+  // Reduce the matrix to the identity with plane rotations that each zero
+  // one element below the diagonal (Givens rotations). Their product q
+  // undoes the matrix, so the matrix is the reverse of q.
+  glm::mat4 m = rotation;
+  Rotor4 q;
+  for (int column = 0; column < 3; ++column) {
+    for (int row = column + 1; row < 4; ++row) {
+      const float angle = std::atan2(-m[column][row], m[column][column]);
+      const float c = std::cos(angle);
+      const float s = std::sin(angle);
+      for (int k = 0; k < 4; ++k) {
+        const float a = m[k][column];
+        const float b = m[k][row];
+        m[k][column] = c * a - s * b;
+        m[k][row] = s * a + c * b;
+      }
+      q = FromPlane(column, row, angle) * q;
+    }
+  }
+  q.Normalize();
+  return q.Reverse();
+}
+
+Rotor4 Rotor4::operator*(const Rotor4& b) const {
+  const Rotor4& a = *this;
+  Rotor4 r;
+  r.s_ = a.s_ * b.s_ - a.b01_ * b.b01_ - a.b02_ * b.b02_ - a.b03_ * b.b03_ -
+         a.b12_ * b.b12_ - a.b13_ * b.b13_ - a.b23_ * b.b23_ + a.p_ * b.p_;
+  r.b01_ = a.s_ * b.b01_ + a.b01_ * b.s_ - a.b02_ * b.b12_ -
+           a.b03_ * b.b13_ + a.b12_ * b.b02_ + a.b13_ * b.b03_ -
+           a.b23_ * b.p_ - a.p_ * b.b23_;
+  r.b02_ = a.s_ * b.b02_ + a.b01_ * b.b12_ + a.b02_ * b.s_ -
+           a.b03_ * b.b23_ - a.b12_ * b.b01_ + a.b13_ * b.p_ +
+           a.b23_ * b.b03_ + a.p_ * b.b13_;
+  r.b03_ = a.s_ * b.b03_ + a.b01_ * b.b13_ + a.b02_ * b.b23_ +
+           a.b03_ * b.s_ - a.b12_ * b.p_ - a.b13_ * b.b01_ -
+           a.b23_ * b.b02_ - a.p_ * b.b12_;
+  r.b12_ = a.s_ * b.b12_ - a.b01_ * b.b02_ + a.b02_ * b.b01_ -
+           a.b03_ * b.p_ + a.b12_ * b.s_ - a.b13_ * b.b23_ +
+           a.b23_ * b.b13_ - a.p_ * b.b03_;
+  r.b13_ = a.s_ * b.b13_ - a.b01_ * b.b03_ + a.b02_ * b.p_ +
+           a.b03_ * b.b01_ + a.b12_ * b.b23_ + a.b13_ * b.s_ -
+           a.b23_ * b.b12_ + a.p_ * b.b02_;
+  r.b23_ = a.s_ * b.b23_ - a.b01_ * b.p_ - a.b02_ * b.b03_ +
+           a.b03_ * b.b02_ - a.b12_ * b.b13_ + a.b13_ * b.b12_ +
+           a.b23_ * b.s_ - a.p_ * b.b01_;
+  r.p_ = a.s_ * b.p_ + a.b01_ * b.b23_ - a.b02_ * b.b13_ + a.b03_ * b.b12_ +
+         a.b12_ * b.b03_ - a.b13_ * b.b02_ + a.b23_ * b.b01_ + a.p_ * b.s_;
+  return r;
+}
+
+Rotor4 Rotor4::Reverse() const {
+  Rotor4 r = *this;
+  r.b01_ = -b01_;
+  r.b02_ = -b02_;
+  r.b03_ = -b03_;
+  r.b12_ = -b12_;
+  r.b13_ = -b13_;
+  r.b23_ = -b23_;
+  return r;
+}
+
+glm::vec4 Rotor4::Rotate(const glm::vec4& v) const {
+  // t = R v has a vector and a trivector part; the vector part of
+  // t reverse(R) is the rotated vector.
+  const float x = s_ * v.x + b01_ * v.y + b02_ * v.z + b03_ * v.w;
+  const float y = s_ * v.y - b01_ * v.x + b12_ * v.z + b13_ * v.w;
+  const float z = s_ * v.z - b02_ * v.x - b12_ * v.y + b23_ * v.w;
+  const float w = s_ * v.w - b03_ * v.x - b13_ * v.y - b23_ * v.z;
+  const float t012 = b01_ * v.z - b02_ * v.y + b12_ * v.x + p_ * v.w;
+  const float t013 = b01_ * v.w - b03_ * v.y + b13_ * v.x - p_ * v.z;
+  const float t023 = b02_ * v.w - b03_ * v.z + b23_ * v.x + p_ * v.y;
+  const float t123 = b12_ * v.w - b13_ * v.z + b23_ * v.y - p_ * v.x;
+  return glm::vec4(x * s_ + y * b01_ + z * b02_ + w * b03_ + t012 * b12_ +
+                       t013 * b13_ + t023 * b23_ + t123 * p_,
+                   -x * b01_ + y * s_ + z * b12_ + w * b13_ - t012 * b02_ -
+                       t013 * b03_ - t023 * p_ + t123 * b23_,
+                   -x * b02_ - y * b12_ + z * s_ + w * b23_ + t012 * b01_ +
+                       t013 * p_ - t023 * b03_ - t123 * b13_,
+                   -x * b03_ - y * b13_ - z * b23_ + w * s_ - t012 * p_ +
+                       t013 * b01_ + t023 * b02_ + t123 * b12_);
+}
+
+void Rotor4::Normalize() {
+  // R reverse(R) = a + b I for the pseudoscalar I, and is 1 for a rotation.
+  // Multiplying R by the inverse square root of a + b I makes it 1 again.
+  // Composition only moves a + b I slightly away from 1, where one Newton
+  // step from 1, (3 - (a + b I)) / 2, is that inverse square root to second
+  // order, so renormalizing after every composition needs no square roots.
+  const float a = s_ * s_ + b01_ * b01_ + b02_ * b02_ + b03_ * b03_ +
+                  b12_ * b12_ + b13_ * b13_ + b23_ * b23_ + p_ * p_;
+  const float b =
+      2.0f * (s_ * p_ - b01_ * b23_ + b02_ * b13_ - b03_ * b12_);
+  const float alpha = 0.5f * (3.0f - a);
+  const float beta = -0.5f * b;
+
+  // R (alpha + beta I).
+  const Rotor4 r = *this;
+  s_ = alpha * r.s_ + beta * r.p_;
+  b01_ = alpha * r.b01_ - beta * r.b23_;
+  b02_ = alpha * r.b02_ + beta * r.b13_;
+  b03_ = alpha * r.b03_ - beta * r.b12_;
+  b12_ = alpha * r.b12_ - beta * r.b03_;
+  b13_ = alpha * r.b13_ + beta * r.b02_;
+  b23_ = alpha * r.b23_ - beta * r.b01_;
+  p_ = alpha * r.p_ + beta * r.s_;
+}
+
+glm::mat4 Rotor4::ToMatrix() const {
+  return glm::mat4(
+      Rotate(glm::vec4(1, 0, 0, 0)), Rotate(glm::vec4(0, 1, 0, 0)),
+      Rotate(glm::vec4(0, 0, 1, 0)), Rotate(glm::vec4(0, 0, 0, 1)));
+}
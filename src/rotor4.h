@@ -0,0 +1,56 @@
+// Rotations of 4D space as rotors: the even-grade elements of the geometric
+// algebra of four dimensions, with a scalar, six bivector components (one
+// per plane of rotation) and a pseudoscalar. A vector v rotates to
+// R v reverse(R).
+//
+// Composing two rotors costs 64 multiplications against 125 for two mat5,
+// and a drifting rotor is brought back to an exact rotation by a closed-form
+// renormalization, where a drifting matrix needs a full orthonormalization.
+// Rotors follow the axis order of mat5: x, y, 'w' (ana), z.
+
+#ifndef ROTOR4_H_
+#define ROTOR4_H_
+
+#include "glm/glm.hpp"
+
+class Rotor4 {
+ public:
+  // The identity.
+  Rotor4();
+
+  // Rotation in the plane of two axes by angle, turning axis_a towards
+  // axis_b, like mat5::rotate.
+  static Rotor4 FromPlane(int axis_a, int axis_b, float angle);
+
+  // The rotor of an orthonormal matrix with determinant 1, such as the 4x4
+  // part of mat5::lookAt.
+  static Rotor4 FromMatrix(const glm::mat4& rotation);
+
+  // The rotation that applies other first, then this one.
+  Rotor4 operator*(const Rotor4& other) const;
+
+  // The inverse rotation.
+  Rotor4 Reverse() const;
+
+  glm::vec4 Rotate(const glm::vec4& v) const;
+
+  // Brings the rotor back to a rotation, removing the error that repeated
+  // composition accumulates. Meant to be called after every composition, as
+  // it assumes the rotor is already close to a rotation.
+  void Normalize();
+
+  // The rotation matrix, with the rotated axes as columns.
+  glm::mat4 ToMatrix() const;
+
+ private:
+  float s_;
+  float b01_;
+  float b02_;
+  float b03_;
+  float b12_;
+  float b13_;
+  float b23_;
+  float p_;
+};
+
+#endif  // ROTOR4_H_
@@ -0,0 +1,280 @@
+#include "scene_binary.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+const char kMagic[4] = {'T', '4', 'D', '\x1a'};
+
+// Largest bounding box extent a 64-bit Morton code can hold per axis.
+const int64_t kMaxExtent = 1 << 16;
+
+// Spreads the low 16 bits of v so that bit i lands on bit 4 * i.
+uint64_t SpreadBits(uint64_t v) {
+  v &= 0xffff;
+  v = (v | (v << 24)) & 0x000000ff000000ffull;
+  v = (v | (v << 12)) & 0x000f000f000f000full;
+  v = (v | (v << 6)) & 0x0303030303030303ull;
+  v = (v | (v << 3)) & 0x1111111111111111ull;
+  return v;
+}
+
+uint64_t CompactBits(uint64_t v) {
+  v &= 0x1111111111111111ull;
+  v = (v | (v >> 3)) & 0x0303030303030303ull;
+  v = (v | (v >> 6)) & 0x000f000f000f000full;
+  v = (v | (v >> 12)) & 0x000000ff000000ffull;
+  v = (v | (v >> 24)) & 0xffff;
+  return v;
+}
+
+uint64_t MortonEncode(const glm::ivec4& offset) {
+  return SpreadBits(offset.x) | (SpreadBits(offset.y) << 1) |
+         (SpreadBits(offset.z) << 2) | (SpreadBits(offset.w) << 3);
+}
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  unsigned char first;
+  memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+void PutLE(uint64_t value, size_t n_bytes, unsigned char* out) {
+  for (size_t i = 0; i < n_bytes; ++i) {
+    out[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+}
+
+uint64_t GetLE(const char* data, size_t n_bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < n_bytes; ++i) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+size_t SceneBinary::GetRawOffset(const Header& header) {
+  return static_cast<size_t>((header.header_size + header.stream_size + 7) &
+                             ~static_cast<uint64_t>(7));
+}
+
+bool SceneBinary::ReadHeader(const char* data, size_t file_size,
+                             Header* header, std::string* error) {
+  if (file_size < kHeaderSize || memcmp(data, kMagic, 4) != 0) {
+    *error = "not a .t4d scene";
+    return false;
+  }
+  header->version = static_cast<uint16_t>(GetLE(data + 4, 2));
+  header->header_size = static_cast<uint16_t>(GetLE(data + 6, 2));
+  header->count = GetLE(data + 8, 8);
+  for (int i = 0; i < 4; ++i) {
+    header->min[i] = static_cast<int32_t>(GetLE(data + 16 + 4 * i, 4));
+    header->max[i] = static_cast<int32_t>(GetLE(data + 32 + 4 * i, 4));
+  }
+  header->flags = static_cast<uint32_t>(GetLE(data + 48, 4));
+  header->encoding = static_cast<uint32_t>(GetLE(data + 52, 4));
+  header->stream_size = GetLE(data + 56, 8);
+
+  if (header->version != kVersion) {
+    char message[64];
+    snprintf(message, sizeof(message), "unsupported .t4d version %u",
+             static_cast<unsigned>(header->version));
+    *error = message;
+    return false;
+  }
+  if (header->header_size < kHeaderSize ||
+      header->stream_size > file_size - header->header_size) {
+    *error = "truncated .t4d header or coordinate stream";
+    return false;
+  }
+  if ((header->flags & FLAG_RAW_INT16) != 0 &&
+      (GetRawOffset(*header) > file_size ||
+       header->count > (file_size - GetRawOffset(*header)) / 8)) {
+    *error = "truncated .t4d raw block";
+    return false;
+  }
+  return true;
+}
+
+glm::ivec4 SceneBinary::MortonDecode(uint64_t code) {
+  return glm::ivec4(static_cast<int>(CompactBits(code)),
+                    static_cast<int>(CompactBits(code >> 1)),
+                    static_cast<int>(CompactBits(code >> 2)),
+                    static_cast<int>(CompactBits(code >> 3)));
+}
+
+bool SceneBinary::IsBinary(const char* data, size_t size) {
+  return size >= 4 && memcmp(data, kMagic, 4) == 0;
+}
+
+const int16_t* SceneBinary::GetRawBlocks(const char* data, size_t size,
+                                         uint64_t* count) {
+  Header header;
+  std::string error;
+  if (!IsLittleEndian() || !ReadHeader(data, size, &header, &error) ||
+      (header.flags & FLAG_RAW_INT16) == 0) {
+    return nullptr;
+  }
+  const char* raw = data + GetRawOffset(header);
+  if (reinterpret_cast<uintptr_t>(raw) % alignof(int16_t) != 0) {
+    return nullptr;
+  }
+  *count = header.count;
+  return reinterpret_cast<const int16_t*>(raw);
+}
+
+bool SceneBinary::Parse(const char* data, size_t size,
+                        std::vector<glm::ivec4>* positions,
+                        std::string* error) {
+  Header header;
+  if (!ReadHeader(data, size, &header, error)) {
+    return false;
+  }
+  size_t offset = positions->size();
+
+  // The raw block needs no decoding.
+  uint64_t raw_count = 0;
+  const int16_t* raw = GetRawBlocks(data, size, &raw_count);
+  if (raw != nullptr) {
+    positions->resize(offset + raw_count);
+    for (uint64_t i = 0; i < raw_count; ++i) {
+      (*positions)[offset + i] = glm::ivec4(raw[4 * i], raw[4 * i + 1],
+                                            raw[4 * i + 2], raw[4 * i + 3]);
+    }
+    return true;
+  }
+
+  if (header.encoding != ENCODING_MORTON_DELTA_VARINT) {
+    *error = "unknown .t4d coordinate encoding";
+    return false;
+  }
+  // Every block takes at least one byte of the stream.
+  if (header.count > header.stream_size) {
+    *error = "block count exceeds the .t4d coordinate stream";
+    return false;
+  }
+
+  positions->resize(offset + header.count);
+  const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(data) + header.header_size;
+  const unsigned char* end = p + header.stream_size;
+  const glm::ivec4 extent = header.max - header.min;
+  uint64_t code = 0;
+  for (uint64_t i = 0; i < header.count; ++i) {
+    uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end || shift > 63) {
+        positions->resize(offset);
+        *error = "corrupt .t4d coordinate stream";
+        return false;
+      }
+      delta |= static_cast<uint64_t>(*p & 0x7f) << shift;
+      if ((*p++ & 0x80) == 0) {
+        break;
+      }
+    }
+    code += delta;
+    glm::ivec4 cell = MortonDecode(code);
+    if (glm::any(glm::greaterThan(cell, extent))) {
+      positions->resize(offset);
+      *error = "block outside of the .t4d bounding box";
+      return false;
+    }
+    (*positions)[offset + i] = header.min + cell;
+  }
+  return true;
+}
+
+bool SceneBinary::Write(const std::string& path,
+                        const std::vector<glm::ivec4>& positions,
+                        bool write_raw, std::string* error) {
+  glm::ivec4 min(0);
+  glm::ivec4 max(0);
+  if (!positions.empty()) {
+    min = max = positions[0];
+    for (const glm::ivec4& position : positions) {
+      min = glm::min(min, position);
+      max = glm::max(max, position);
+    }
+  }
+  for (int i = 0; i < 4; ++i) {
+    if (static_cast<int64_t>(max[i]) - min[i] >= kMaxExtent) {
+      *error = "scene is more than 65536 blocks across";
+      return false;
+    }
+  }
+  write_raw = write_raw &&
+              glm::all(glm::greaterThanEqual(
+                  min, glm::ivec4(std::numeric_limits<int16_t>::min()))) &&
+              glm::all(glm::lessThanEqual(
+                  max, glm::ivec4(std::numeric_limits<int16_t>::max())));
+
+  std::vector<uint64_t> codes(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    codes[i] = MortonEncode(positions[i] - min);
+  }
+  std::sort(codes.begin(), codes.end());
+
+  std::vector<unsigned char> stream;
+  stream.reserve(positions.size() + positions.size() / 4);
+  uint64_t previous = 0;
+  for (uint64_t code : codes) {
+    uint64_t delta = code - previous;
+    previous = code;
+    while (delta >= 0x80) {
+      stream.push_back(static_cast<unsigned char>(delta | 0x80));
+      delta >>= 7;
+    }
+    stream.push_back(static_cast<unsigned char>(delta));
+  }
+
+  unsigned char header[kHeaderSize];
+  memset(header, 0, sizeof(header));
+  memcpy(header, kMagic, 4);
+  PutLE(kVersion, 2, header + 4);
+  PutLE(kHeaderSize, 2, header + 6);
+  PutLE(positions.size(), 8, header + 8);
+  for (int i = 0; i < 4; ++i) {
+    PutLE(static_cast<uint32_t>(min[i]), 4, header + 16 + 4 * i);
+    PutLE(static_cast<uint32_t>(max[i]), 4, header + 32 + 4 * i);
+  }
+  PutLE(write_raw ? FLAG_RAW_INT16 : 0, 4, header + 48);
+  PutLE(ENCODING_MORTON_DELTA_VARINT, 4, header + 52);
+  PutLE(stream.size(), 8, header + 56);
+
+  FILE* out = fopen(path.c_str(), "wb");
+  if (out == nullptr) {
+    *error = "could not open the file for writing";
+    return false;
+  }
+  bool ok = fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+            fwrite(stream.data(), 1, stream.size(), out) == stream.size();
+  if (ok && write_raw) {
+    static const unsigned char kPadding[8] = {0};
+    size_t padding = (8 - (kHeaderSize + stream.size()) % 8) % 8;
+    ok = fwrite(kPadding, 1, padding, out) == padding;
+
+    // Same Morton order as the stream.
+    unsigned char raw[8];
+    for (size_t i = 0; ok && i < codes.size(); ++i) {
+      glm::ivec4 position = min + MortonDecode(codes[i]);
+      for (int axis = 0; axis < 4; ++axis) {
+        PutLE(static_cast<uint16_t>(position[axis]), 2, raw + 2 * axis);
+      }
+      ok = fwrite(raw, 1, sizeof(raw), out) == sizeof(raw);
+    }
+  }
+  if (fclose(out) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    *error = "could not write the file";
+  }
+  return ok;
+}
@@ -0,0 +1,217 @@
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "mapped_file.h"
+#include "scene_binary.h"
+
+namespace {
+// Smallest range handed to a parsing thread.
+const size_t kMinBytesPerThread = 1 << 20;
+
+struct Range {
+  Range() : begin(nullptr), end(nullptr), n_lines(0), failed(false) {}
+
+  const char* begin;
+  const char* end;
+  std::vector<glm::ivec4> positions;
+  size_t n_lines;
+
+  // Error position relative to the start of the range.
+  bool failed;
+  SceneFile::Error error;
+};
+
+inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Locale-independent integer parsing in the spirit of std::from_chars.
+// Returns nullptr on success or a description of the problem.
+const char* ParseInt(const char** cursor, const char* end, int* value) {
+  const char* p = *cursor;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  if (p == end || !IsDigit(*p)) {
+    return "expected an integer";
+  }
+  int64_t magnitude = 0;
+  while (p < end && IsDigit(*p)) {
+    magnitude = magnitude * 10 + (*p - '0');
+    if (magnitude > static_cast<int64_t>(INT32_MAX) + 1) {
+      return "integer out of range";
+    }
+    ++p;
+  }
+  if (!negative && magnitude > INT32_MAX) {
+    return "integer out of range";
+  }
+  *value = static_cast<int>(negative ? -magnitude : magnitude);
+  *cursor = p;
+  return nullptr;
+}
+
+void ParseRange(Range* range) {
+  range->positions.reserve((range->end - range->begin) / 8);
+  const char* p = range->begin;
+  const char* end = range->end;
+  while (p < end) {
+    const char* line_start = p;
+    while (p < end && IsBlank(*p)) {
+      ++p;
+    }
+    if (p < end && *p != '\n') {
+      // File order is x y w z; positions are stored as x y z w.
+      int v[4];
+      for (int i = 0; i < 4; ++i) {
+        while (p < end && IsBlank(*p)) {
+          ++p;
+        }
+        const char* message = p == end || *p == '\n'
+                                  ? "expected 4 coordinates"
+                                  : ParseInt(&p, end, &v[i]);
+        if (message == nullptr && i < 3 && p < end && !IsBlank(*p) &&
+            *p != '\n') {
+          message = "expected whitespace between coordinates";
+        }
+        if (message != nullptr) {
+          range->failed = true;
+          range->error.line = range->n_lines + 1;
+          range->error.column = p - line_start + 1;
+          range->error.message = message;
+          return;
+        }
+      }
+      while (p < end && IsBlank(*p)) {
+        ++p;
+      }
+      if (p < end && *p != '\n') {
+        range->failed = true;
+        range->error.line = range->n_lines + 1;
+        range->error.column = p - line_start + 1;
+        range->error.message = "expected the end of the line";
+        return;
+      }
+      range->positions.push_back(glm::ivec4(v[0], v[1], v[3], v[2]));
+    }
+    if (p < end) {
+      ++p;  // Newline.
+      ++range->n_lines;
+    }
+  }
+}
+}  // namespace
+
+bool SceneFile::Parse(const char* data, size_t size,
+                      std::vector<glm::ivec4>* positions, Error* error,
+                      unsigned n_threads) {
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t n_ranges = std::min<size_t>(n_threads, size / kMinBytesPerThread);
+  n_ranges = std::max<size_t>(n_ranges, 1);
+
+  // Split at newlines so that no line straddles two ranges.
+  std::vector<Range> ranges(n_ranges);
+  const char* begin = data;
+  const char* data_end = data + size;
+  for (size_t i = 0; i < n_ranges; ++i) {
+    const char* end = data + size * (i + 1) / n_ranges;
+    if (i + 1 == n_ranges) {
+      end = data_end;
+    } else if (end < begin) {
+      end = begin;
+    } else {
+      const void* newline = memchr(end, '\n', data_end - end);
+      end = newline != nullptr ? static_cast<const char*>(newline) + 1
+                               : data_end;
+    }
+    ranges[i].begin = begin;
+    ranges[i].end = end;
+    begin = end;
+  }
+
+  if (n_ranges == 1) {
+    ParseRange(&ranges[0]);
+  } else {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n_ranges; ++i) {
+      threads.push_back(std::thread(ParseRange, &ranges[i]));
+    }
+    ParseRange(&ranges[0]);
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  // Report the earliest error with its line number in the whole file.
+  size_t lines_before = 0;
+  size_t n_positions = 0;
+  for (const Range& range : ranges) {
+    if (range.failed) {
+      if (error != nullptr) {
+        *error = range.error;
+        error->line += lines_before;
+      }
+      return false;
+    }
+    lines_before += range.n_lines;
+    n_positions += range.positions.size();
+  }
+
+  size_t offset = positions->size();
+  positions->resize(offset + n_positions);
+  for (const Range& range : ranges) {
+    std::copy(range.positions.begin(), range.positions.end(),
+              positions->begin() + offset);
+    offset += range.positions.size();
+  }
+  return true;
+}
+
+bool SceneFile::Load(const std::string& path,
+                     std::vector<glm::ivec4>* positions) {
+  MappedFile file;
+  if (!file.Open(path)) {
+    fprintf(stderr, "Could not read \"%s\"\n", path.c_str());
+    return false;
+  }
+  if (SceneBinary::IsBinary(file.GetData(), file.GetSize())) {
+    std::string message;
+    if (!SceneBinary::Parse(file.GetData(), file.GetSize(), positions,
+                            &message)) {
+      fprintf(stderr, "%s: %s\n", path.c_str(), message.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  Error error;
+  if (!Parse(file.GetData(), file.GetSize(), positions, &error)) {
+    fprintf(stderr, "%s:%zu:%zu: %s\n", path.c_str(), error.line,
+            error.column, error.message.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SceneFile::Write(const std::string& path,
+                      const std::vector<glm::ivec4>& positions) {
+  FILE* out = fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "Could not write \"%s\"\n", path.c_str());
+    return false;
+  }
+  for (const glm::ivec4& position : positions) {
+    fprintf(out, "%d %d %d %d\n", position.x, position.y, position.w,
+            position.z);
+  }
+  return fclose(out) == 0;
+}
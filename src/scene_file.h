@@ -0,0 +1,46 @@
+// Reader for the plain-text scene format: one tesseract per line given as
+// integer "x y w z" coordinates, as in the files under scenes/.
+//
+// Files are memory-mapped and split into newline-aligned ranges that are
+// parsed in parallel straight into one contiguous coordinate array. Load()
+// also accepts binary .t4d scenes, recognized by their magic number.
+
+#ifndef SCENE_FILE_H_
+#define SCENE_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class SceneFile {
+ public:
+  // Position of the first malformed entry, both 1-based.
+  struct Error {
+    Error() : line(0), column(0) {}
+
+    size_t line;
+    size_t column;
+    std::string message;
+  };
+
+  // Parses scene text into block positions stored as (x, y, z, w). Blank
+  // lines are skipped. Inputs large enough to benefit are split across up to
+  // n_threads threads; 0 uses every hardware thread. Returns false and fills
+  // in the error of the earliest malformed line on failure.
+  static bool Parse(const char* data, size_t size,
+                    std::vector<glm::ivec4>* positions, Error* error,
+                    unsigned n_threads = 0);
+
+  // Maps and parses the text or .t4d scene file at the given path, printing
+  // "<path>:<line>:<column>: <message>" on errors.
+  static bool Load(const std::string& path,
+                   std::vector<glm::ivec4>* positions);
+
+  // Writes positions in the text format.
+  static bool Write(const std::string& path,
+                    const std::vector<glm::ivec4>& positions);
+};
+
+#endif  // SCENE_FILE_H_
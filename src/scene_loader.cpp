@@ -0,0 +1,170 @@
+#include "scene_loader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "startup_timer.h"
+#include "terrain.h"
+
+namespace {
+// Blocks the ring holds, 16 MiB of centers.
+const size_t kPendingBlocks = 1 << 20;
+
+// Blocks passed to the sink at a time by generated terrain.
+const size_t kTerrainBatch = 1 << 14;
+}  // namespace
+
+std::unique_ptr<SceneLoader> SceneLoader::FromFile(const std::string& path) {
+  std::shared_ptr<SceneStream> stream(new SceneStream());
+  if (!stream->Open(path)) {
+    return std::unique_ptr<SceneLoader>();
+  }
+  std::unique_ptr<SceneLoader> loader(new SceneLoader(
+      stream->GetCapacity(), [stream](const SceneStream::Sink& sink) {
+        StartupTimer::GetInstance()->Begin(StartupTimer::PHASE_PARSE);
+        bool loaded = stream->Run(sink);
+        StartupTimer::GetInstance()->End(StartupTimer::PHASE_PARSE);
+        return loaded;
+      }));
+  loader->path_ = path;
+  return loader;
+}
+
+std::unique_ptr<SceneLoader> SceneLoader::FromTerrain(const glm::ivec4& size,
+                                                      float persistence,
+                                                      float frequency,
+                                                      int noise_mode) {
+  uint64_t capacity = static_cast<uint64_t>(std::max(size.x, 0)) *
+                      std::max(size.y, 0) * std::max(size.z, 0) *
+                      std::max(size.w, 0);
+  return std::unique_ptr<SceneLoader>(new SceneLoader(
+      capacity, [size, persistence, frequency,
+                 noise_mode](const SceneStream::Sink& sink) {
+        StartupTimer::GetInstance()->Begin(StartupTimer::PHASE_TERRAIN);
+        Terrain::Chunk chunk(size, persistence, frequency, noise_mode);
+        std::vector<Terrain::Block*> blocks = chunk.GetAllBlocks();
+        StartupTimer::GetInstance()->End(StartupTimer::PHASE_TERRAIN);
+
+        std::vector<glm::vec4> batch;
+        batch.reserve(kTerrainBatch);
+        uint64_t n_blocks = 0;
+        for (Terrain::Block* block : blocks) {
+          if (block->GetType() > 0) {
+            batch.push_back(glm::vec4(block->GetPos()));
+          }
+          if (batch.size() == kTerrainBatch) {
+            if (!sink(n_blocks, batch.data(), batch.size())) {
+              return false;
+            }
+            n_blocks += batch.size();
+            batch.clear();
+          }
+        }
+        return batch.empty() || sink(n_blocks, batch.data(), batch.size());
+      }));
+}
+
+SceneLoader::SceneLoader(uint64_t capacity, const Producer& producer)
+    : capacity_(capacity),
+      n_taken_(0),
+      producer_(producer),
+      pending_(kPendingBlocks),
+      head_(0),
+      n_pending_(0),
+      finished_(false),
+      succeeded_(false),
+      stopping_(false) {}
+
+SceneLoader::~SceneLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  space_ready_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void SceneLoader::Start() { thread_ = std::thread(&SceneLoader::Load, this); }
+
+void SceneLoader::Load() {
+  uint64_t n_produced = 0;
+  bool succeeded = producer_(
+      [this, &n_produced](uint64_t, const glm::vec4* centers,
+                          size_t n_blocks) {
+        if (n_blocks > capacity_ - n_produced) {
+          fprintf(stderr, "Scene loader: more blocks than expected\n");
+          return false;
+        }
+        n_produced += n_blocks;
+        return Put(centers, n_blocks);
+      });
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    succeeded_ = succeeded;
+  }
+  blocks_ready_.notify_all();
+}
+
+bool SceneLoader::Put(const glm::vec4* centers, size_t n_blocks) {
+  while (n_blocks > 0) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      space_ready_.wait(lock, [this] {
+        return stopping_ || n_pending_ < pending_.size();
+      });
+      if (stopping_) {
+        return false;
+      }
+      size_t tail = (head_ + n_pending_) % pending_.size();
+      size_t n = std::min(n_blocks, pending_.size() - n_pending_);
+      n = std::min(n, pending_.size() - tail);
+      std::copy(centers, centers + n, pending_.begin() + tail);
+      n_pending_ += n;
+      centers += n;
+      n_blocks -= n;
+    }
+    blocks_ready_.notify_one();
+  }
+  return true;
+}
+
+size_t SceneLoader::Take(size_t max_blocks, std::vector<glm::vec4>* blocks,
+                         bool wait) {
+  size_t n;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait) {
+      blocks_ready_.wait(lock,
+                         [this] { return n_pending_ > 0 || finished_; });
+    }
+    n = std::min(max_blocks, n_pending_);
+    blocks->resize(n);
+
+    // The queued blocks wrap around the end of the ring at most once.
+    size_t first = std::min(n, pending_.size() - head_);
+    std::copy(pending_.begin() + head_, pending_.begin() + head_ + first,
+              blocks->begin());
+    std::copy(pending_.begin(), pending_.begin() + (n - first),
+              blocks->begin() + first);
+    head_ = (head_ + n) % pending_.size();
+    n_pending_ -= n;
+  }
+  n_taken_ += n;
+  if (n > 0) {
+    space_ready_.notify_one();
+  }
+  return n;
+}
+
+bool SceneLoader::IsDone() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return finished_ && n_pending_ == 0;
+}
+
+bool SceneLoader::Succeeded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return succeeded_;
+}
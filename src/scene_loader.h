@@ -0,0 +1,96 @@
+// Background production of a scene's blocks while the app is already
+// rendering. A loader thread reads a scene file or generates terrain and
+// queues the block centers in a fixed-size ring; the render loop takes a
+// bounded batch each frame and appends it to the GPU scene. When the ring is
+// full the loader thread waits, so a slow consumer holds back production
+// instead of buffering the whole scene.
+//
+// The number of blocks is bounded up front by GetCapacity(), so the GPU
+// buffers and shaders can be sized before any block has been produced.
+
+#ifndef SCENE_LOADER_H_
+#define SCENE_LOADER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "scene_stream.h"
+
+class SceneLoader {
+ public:
+  // Runs on the loader thread and passes every block to the sink, in scene
+  // order. Returns false if the scene could not be produced in full.
+  typedef std::function<bool(const SceneStream::Sink& sink)> Producer;
+
+  // Streams a text or .t4d scene file. Returns nullptr, after printing the
+  // problem, if the file cannot be opened.
+  static std::unique_ptr<SceneLoader> FromFile(const std::string& path);
+
+  // Generates a Terrain::Chunk of the given size and keeps its solid blocks.
+  static std::unique_ptr<SceneLoader> FromTerrain(const glm::ivec4& size,
+                                                  float persistence,
+                                                  float frequency,
+                                                  int noise_mode);
+
+  SceneLoader(uint64_t capacity, const Producer& producer);
+
+  // Stops the producer at its next block and waits for the thread.
+  ~SceneLoader();
+
+  // Starts the loader thread.
+  void Start();
+
+  // The scene file being loaded, or an empty string for generated terrain.
+  const std::string& GetPath() const { return path_; }
+
+  // Upper bound on the number of blocks the producer delivers.
+  uint64_t GetCapacity() const { return capacity_; }
+
+  // Upper bound on the number of blocks not taken yet.
+  uint64_t GetRemainingCapacity() const { return capacity_ - n_taken_; }
+
+  // Moves up to max_blocks queued blocks, in scene order, into blocks and
+  // returns their number. Returns at once unless wait is set, in which case
+  // it waits for at least one block or the end of the scene.
+  size_t Take(size_t max_blocks, std::vector<glm::vec4>* blocks, bool wait);
+
+  // Whether the producer has finished and every block has been taken.
+  bool IsDone();
+
+  // Whether the producer delivered the whole scene. Valid once IsDone().
+  bool Succeeded();
+
+ private:
+  SceneLoader(const SceneLoader&);
+  SceneLoader& operator=(const SceneLoader&);
+
+  void Load();
+  bool Put(const glm::vec4* centers, size_t n_blocks);
+
+  const uint64_t capacity_;
+  uint64_t n_taken_;
+  Producer producer_;
+  std::string path_;
+  std::thread thread_;
+
+  // Ring of produced blocks, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable space_ready_;
+  std::condition_variable blocks_ready_;
+  std::vector<glm::vec4> pending_;
+  size_t head_;
+  size_t n_pending_;
+  bool finished_;
+  bool succeeded_;
+  bool stopping_;
+};
+
+#endif  // SCENE_LOADER_H_
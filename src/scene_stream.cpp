@@ -0,0 +1,451 @@
+#include "scene_stream.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+bool Seek(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool GetFileSize(FILE* file, uint64_t* size) {
+#ifdef _WIN32
+  if (_fseeki64(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  __int64 end = _ftelli64(file);
+#else
+  if (fseeko(file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  off_t end = ftello(file);
+#endif
+  if (end < 0) {
+    return false;
+  }
+  *size = static_cast<uint64_t>(end);
+  return Seek(file, 0);
+}
+
+// Shortest text line holding a block: "0 0 0 0\n".
+const uint64_t kMinLineSize = 8;
+}  // namespace
+
+SceneStream::SceneStream() : SceneStream(Options()) {}
+
+SceneStream::SceneStream(const Options& options)
+    : options_(options),
+      file_(nullptr),
+      file_size_(0),
+      mode_(MODE_TEXT),
+      capacity_(0),
+      n_blocks_(0),
+      n_read_(0),
+      text_end_(false),
+      stream_position_(0),
+      stream_left_(0),
+      code_(0),
+      next_work_(0),
+      n_chunks_(0),
+      read_finished_(false),
+      stopping_(false),
+      failed_(false) {
+  options_.chunk_size = std::max<size_t>(options_.chunk_size, 64);
+}
+
+SceneStream::~SceneStream() { Close(); }
+
+void SceneStream::Close() {
+  if (file_ != nullptr) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool SceneStream::Open(const std::string& path) {
+  Close();
+  path_ = path;
+  capacity_ = 0;
+  n_blocks_ = 0;
+  n_read_ = 0;
+  carry_.clear();
+  text_end_ = false;
+  stream_buffer_.clear();
+  stream_position_ = 0;
+  stream_left_ = 0;
+  code_ = 0;
+
+  file_ = fopen(path.c_str(), "rb");
+  if (file_ == nullptr || !GetFileSize(file_, &file_size_)) {
+    fprintf(stderr, "Could not read \"%s\"\n", path.c_str());
+    Close();
+    return false;
+  }
+
+  char head[SceneBinary::kHeaderSize];
+  size_t n_head = fread(head, 1, sizeof(head), file_);
+  if (!SceneBinary::IsBinary(head, n_head)) {
+    mode_ = MODE_TEXT;
+    capacity_ = file_size_ / kMinLineSize + 1;
+    if (!Seek(file_, 0)) {
+      fprintf(stderr, "Could not read \"%s\"\n", path.c_str());
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  std::string error;
+  uint64_t offset = 0;
+  if (!SceneBinary::ReadHeader(head, file_size_, &header_, &error)) {
+    // Reported below.
+  } else if ((header_.flags & SceneBinary::FLAG_RAW_INT16) != 0) {
+    mode_ = MODE_RAW_INT16;
+    offset = SceneBinary::GetRawOffset(header_);
+  } else if (header_.encoding != SceneBinary::ENCODING_MORTON_DELTA_VARINT) {
+    error = "unknown .t4d coordinate encoding";
+  } else if (header_.count > header_.stream_size) {
+    // Every block takes at least one byte of the stream.
+    error = "block count exceeds the .t4d coordinate stream";
+  } else {
+    mode_ = MODE_MORTON;
+    offset = header_.header_size;
+    stream_left_ = header_.stream_size;
+  }
+  if (error.empty() && !Seek(file_, offset)) {
+    error = "could not seek to the coordinates";
+  }
+  if (!error.empty()) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+    Close();
+    return false;
+  }
+  capacity_ = header_.count;
+  return true;
+}
+
+bool SceneStream::Run(const Sink& sink) {
+  if (file_ == nullptr) {
+    return false;
+  }
+
+  unsigned n_workers = options_.n_workers;
+  if (n_workers == 0) {
+    unsigned n_threads = std::thread::hardware_concurrency();
+    n_workers = n_threads > 2 ? n_threads - 2 : 1;
+  }
+  size_t depth = options_.queue_depth > 0 ? options_.queue_depth
+                                          : 2 * n_workers;
+  chunks_.resize(depth);
+  free_.clear();
+  for (Chunk& chunk : chunks_) {
+    free_.push_back(&chunk);
+  }
+  work_.assign(depth, nullptr);
+  done_.assign(depth, nullptr);
+  next_work_ = 0;
+  n_chunks_ = 0;
+  read_finished_ = false;
+  stopping_ = false;
+  failed_ = false;
+  message_.clear();
+
+  std::vector<std::thread> threads;
+  threads.push_back(std::thread(&SceneStream::Read, this));
+  for (unsigned i = 0; i < n_workers; ++i) {
+    threads.push_back(std::thread(&SceneStream::Decode, this));
+  }
+
+  // Upload the chunks in file order as they come out of the workers.
+  bool ok = true;
+  size_t lines_before = 0;
+  n_blocks_ = 0;
+  for (uint64_t next = 0;; ++next) {
+    Chunk* chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_ready_.wait(lock, [this, next, depth] {
+        return failed_ || done_[next % depth] != nullptr ||
+               (read_finished_ && next == n_chunks_);
+      });
+      if (failed_) {
+        ok = false;
+        break;
+      }
+      chunk = done_[next % depth];
+      if (chunk == nullptr) {
+        break;
+      }
+      done_[next % depth] = nullptr;
+    }
+
+    if (chunk->failed) {
+      if (mode_ == MODE_TEXT) {
+        fprintf(stderr, "%s:%zu:%zu: %s\n", path_.c_str(),
+                chunk->error.line + lines_before, chunk->error.column,
+                chunk->error.message.c_str());
+      } else {
+        fprintf(stderr, "%s: %s\n", path_.c_str(),
+                chunk->error.message.c_str());
+      }
+      ok = false;
+      break;
+    }
+    size_t n_blocks = chunk->centers.size();
+    if (n_blocks > capacity_ - n_blocks_) {
+      fprintf(stderr, "%s: more blocks than expected\n", path_.c_str());
+      ok = false;
+      break;
+    }
+    if (n_blocks > 0 && !sink(n_blocks_, chunk->centers.data(), n_blocks)) {
+      ok = false;
+      break;
+    }
+    n_blocks_ += n_blocks;
+    lines_before += chunk->n_lines;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(chunk);
+    }
+    free_ready_.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  free_ready_.notify_all();
+  work_ready_.notify_all();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  if (failed_) {
+    fprintf(stderr, "%s: %s\n", path_.c_str(), message_.c_str());
+  }
+  Close();
+  return ok;
+}
+
+void SceneStream::Fail(const std::string& message) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!failed_) {
+      failed_ = true;
+      message_ = message;
+    }
+  }
+  done_ready_.notify_all();
+}
+
+bool SceneStream::IsReadFinished() const {
+  return mode_ == MODE_TEXT ? text_end_ && carry_.empty()
+                            : n_read_ == header_.count;
+}
+
+void SceneStream::Read() {
+  const size_t depth = chunks_.size();
+  for (uint64_t sequence = 0;; ++sequence) {
+    Chunk* chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      free_ready_.wait(lock, [this] { return stopping_ || !free_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      chunk = free_.back();
+      free_.pop_back();
+    }
+
+    chunk->sequence = sequence;
+    bool ok;
+    switch (mode_) {
+      case MODE_RAW_INT16:
+        ok = ReadRaw(chunk);
+        break;
+      case MODE_MORTON:
+        ok = ReadMorton(chunk);
+        break;
+      default:
+        ok = ReadText(chunk);
+        break;
+    }
+    if (!ok) {
+      return;
+    }
+
+    bool finished = IsReadFinished();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      work_[sequence % depth] = chunk;
+      if (finished) {
+        n_chunks_ = sequence + 1;
+        read_finished_ = true;
+      }
+    }
+    work_ready_.notify_one();
+    if (finished) {
+      done_ready_.notify_all();
+      return;
+    }
+  }
+}
+
+bool SceneStream::ReadText(Chunk* chunk) {
+  std::vector<char>& input = chunk->input;
+  input.assign(carry_.begin(), carry_.end());
+  carry_.clear();
+
+  // Read until the chunk ends on a complete line, so lines never straddle
+  // two chunks. Lines longer than a chunk keep extending it.
+  while (!text_end_) {
+    size_t old_size = input.size();
+    input.resize(old_size + options_.chunk_size);
+    size_t n = fread(&input[old_size], 1, options_.chunk_size, file_);
+    input.resize(old_size + n);
+    if (n < options_.chunk_size) {
+      if (ferror(file_)) {
+        Fail("read error");
+        return false;
+      }
+      text_end_ = true;
+      break;
+    }
+    std::vector<char>::reverse_iterator newline =
+        std::find(input.rbegin(), input.rbegin() + n, '\n');
+    if (newline != input.rbegin() + n) {
+      std::vector<char>::iterator line_end = newline.base();
+      carry_.assign(line_end, input.end());
+      input.erase(line_end, input.end());
+      break;
+    }
+  }
+  return true;
+}
+
+bool SceneStream::ReadRaw(Chunk* chunk) {
+  const size_t kBlockSize = 4 * sizeof(int16_t);
+  uint64_t n_blocks = std::min<uint64_t>(
+      header_.count - n_read_,
+      std::max<size_t>(options_.chunk_size / kBlockSize, 1));
+  chunk->input.resize(static_cast<size_t>(n_blocks * kBlockSize));
+  if (fread(chunk->input.data(), 1, chunk->input.size(), file_) !=
+      chunk->input.size()) {
+    Fail("truncated .t4d raw block");
+    return false;
+  }
+  n_read_ += n_blocks;
+  return true;
+}
+
+bool SceneStream::ReadMorton(Chunk* chunk) {
+  // A code takes 8 bytes in the chunk, so chunks hold the same number of
+  // bytes as for the other formats.
+  std::vector<uint64_t>& codes = chunk->codes;
+  codes.clear();
+  const size_t max_codes = std::max<size_t>(options_.chunk_size / 8, 1);
+  while (codes.size() < max_codes && n_read_ < header_.count) {
+    uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+      if (stream_position_ == stream_buffer_.size()) {
+        size_t n = static_cast<size_t>(
+            std::min<uint64_t>(stream_left_, options_.chunk_size));
+        stream_buffer_.resize(n);
+        if (n == 0 || fread(stream_buffer_.data(), 1, n, file_) != n) {
+          Fail("corrupt .t4d coordinate stream");
+          return false;
+        }
+        stream_left_ -= n;
+        stream_position_ = 0;
+      }
+      if (shift > 63) {
+        Fail("corrupt .t4d coordinate stream");
+        return false;
+      }
+      unsigned char byte = stream_buffer_[stream_position_++];
+      delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    code_ += delta;
+    codes.push_back(code_);
+    ++n_read_;
+  }
+  return true;
+}
+
+void SceneStream::Decode() {
+  const size_t depth = chunks_.size();
+  for (;;) {
+    Chunk* chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this, depth] {
+        return stopping_ || work_[next_work_ % depth] != nullptr;
+      });
+      if (stopping_) {
+        return;
+      }
+      chunk = work_[next_work_ % depth];
+      work_[next_work_ % depth] = nullptr;
+      ++next_work_;
+    }
+
+    DecodeChunk(chunk);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_[chunk->sequence % depth] = chunk;
+    }
+    done_ready_.notify_all();
+  }
+}
+
+void SceneStream::DecodeChunk(Chunk* chunk) const {
+  chunk->failed = false;
+  chunk->n_lines = 0;
+  std::vector<glm::vec4>& centers = chunk->centers;
+  centers.clear();
+
+  if (mode_ == MODE_TEXT) {
+    const std::vector<char>& input = chunk->input;
+    chunk->positions.clear();
+    if (!SceneFile::Parse(input.data(), input.size(), &chunk->positions,
+                          &chunk->error, 1)) {
+      chunk->failed = true;
+      return;
+    }
+    chunk->n_lines = std::count(input.begin(), input.end(), '\n');
+    centers.resize(chunk->positions.size());
+    for (size_t i = 0; i < centers.size(); ++i) {
+      centers[i] = glm::vec4(chunk->positions[i]);
+    }
+  } else if (mode_ == MODE_RAW_INT16) {
+    const unsigned char* raw =
+        reinterpret_cast<const unsigned char*>(chunk->input.data());
+    centers.resize(chunk->input.size() / 8);
+    for (size_t i = 0; i < centers.size(); ++i, raw += 8) {
+      for (int axis = 0; axis < 4; ++axis) {
+        centers[i][axis] = static_cast<float>(static_cast<int16_t>(
+            raw[2 * axis] | (raw[2 * axis + 1] << 8)));
+      }
+    }
+  } else {
+    const glm::ivec4 extent = header_.max - header_.min;
+    centers.resize(chunk->codes.size());
+    for (size_t i = 0; i < centers.size(); ++i) {
+      glm::ivec4 cell = SceneBinary::MortonDecode(chunk->codes[i]);
+      if (glm::any(glm::greaterThan(cell, extent))) {
+        chunk->failed = true;
+        chunk->error.message = "block outside of the .t4d bounding box";
+        return;
+      }
+      centers[i] = glm::vec4(header_.min + cell);
+    }
+  }
+}
@@ -0,0 +1,145 @@
+// Pipelined loading of scene files too large to parse and upload in separate
+// passes. A reader thread reads the file in chunks, decode workers turn each
+// chunk into block centers, and the thread calling Run() hands the decoded
+// chunks in file order to a sink, which uploads them. Reading, decoding and
+// uploading all overlap.
+//
+// The chunks form a fixed pool of queue_depth buffers, and a chunk only goes
+// back to the reader after the sink has consumed it, so host memory stays
+// bounded by the queue depth and chunk size rather than by the scene size.
+//
+// Both the text format of SceneFile and .t4d scenes are supported. Morton
+// coded .t4d streams are delta coded, so their varints are decoded on the
+// reader thread and the workers only expand the Morton codes.
+
+#ifndef SCENE_STREAM_H_
+#define SCENE_STREAM_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "scene_binary.h"
+#include "scene_file.h"
+
+class SceneStream {
+ public:
+  struct Options {
+    Options() : chunk_size(4 << 20), n_workers(0), queue_depth(0) {}
+
+    // Bytes of the file read per chunk.
+    size_t chunk_size;
+
+    // Decode threads; 0 uses the hardware threads left over by the reader
+    // and the uploader, and at least one.
+    unsigned n_workers;
+
+    // Chunks in flight between the reader and the sink; 0 uses twice the
+    // number of workers.
+    unsigned queue_depth;
+  };
+
+  // Receives the centers of n_blocks consecutive blocks of the file,
+  // starting with block number first_block. Returning false stops the load.
+  typedef std::function<bool(uint64_t first_block, const glm::vec4* centers,
+                             size_t n_blocks)>
+      Sink;
+
+  SceneStream();
+  explicit SceneStream(const Options& options);
+  ~SceneStream();
+
+  // Opens a text or .t4d scene file and reads its header, if any.
+  bool Open(const std::string& path);
+
+  // Upper bound on the number of blocks in the open file, for sizing the
+  // destination before Run(): exact for .t4d scenes and derived from the
+  // file size for text, whose shortest line takes 8 bytes.
+  uint64_t GetCapacity() const { return capacity_; }
+
+  // Streams every block of the open file into the sink, once per Open().
+  // Errors are printed as by SceneFile::Load(), with line numbers for text
+  // scenes.
+  bool Run(const Sink& sink);
+
+  // Number of blocks passed to the sink by the last Run().
+  uint64_t GetBlockCount() const { return n_blocks_; }
+
+ private:
+  enum Mode { MODE_TEXT, MODE_RAW_INT16, MODE_MORTON };
+
+  struct Chunk {
+    uint64_t sequence;
+
+    // Reader output: file bytes for text and raw scenes, absolute Morton
+    // codes for Morton coded scenes.
+    std::vector<char> input;
+    std::vector<uint64_t> codes;
+
+    // Worker output.
+    std::vector<glm::ivec4> positions;
+    std::vector<glm::vec4> centers;
+    size_t n_lines;
+    bool failed;
+    SceneFile::Error error;
+  };
+
+  SceneStream(const SceneStream&);
+  SceneStream& operator=(const SceneStream&);
+
+  void Close();
+  void Read();
+  bool IsReadFinished() const;
+  bool ReadText(Chunk* chunk);
+  bool ReadRaw(Chunk* chunk);
+  bool ReadMorton(Chunk* chunk);
+  void Decode();
+  void DecodeChunk(Chunk* chunk) const;
+  void Fail(const std::string& message);
+
+  Options options_;
+  std::string path_;
+  FILE* file_;
+  uint64_t file_size_;
+  Mode mode_;
+  SceneBinary::Header header_;
+  uint64_t capacity_;
+  uint64_t n_blocks_;
+
+  // Reader state. Text scenes carry the partial line at the end of a read
+  // over to the next chunk.
+  uint64_t n_read_;
+  std::vector<char> carry_;
+  bool text_end_;
+  std::vector<unsigned char> stream_buffer_;
+  size_t stream_position_;
+  uint64_t stream_left_;
+  uint64_t code_;
+
+  // Pipeline state, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable free_ready_;
+  std::condition_variable work_ready_;
+  std::condition_variable done_ready_;
+  std::vector<Chunk> chunks_;
+  std::vector<Chunk*> free_;
+  // Chunks waiting for a worker and for the sink, in rings indexed by
+  // sequence number modulo the queue depth. Sequence numbers in flight span
+  // less than the queue depth, so slots never collide.
+  std::vector<Chunk*> work_;
+  uint64_t next_work_;
+  std::vector<Chunk*> done_;
+  uint64_t n_chunks_;
+  bool read_finished_;
+  bool stopping_;
+  bool failed_;
+  std::string message_;
+};
+
+#endif  // SCENE_STREAM_H_
@@ -0,0 +1,185 @@
+#include "scene_watcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "scene_file.h"
+
+namespace {
+// How long the watcher sleeps between checks for stopping.
+const int kPollMs = 100;
+
+// Quiet time after the last change before the file is parsed, so an editor
+// that writes in several steps causes a single reload.
+const int kSettleMs = 50;
+
+#ifndef __linux__
+bool GetModification(const std::string& path, struct stat* modification) {
+  return stat(path.c_str(), modification) == 0;
+}
+
+bool IsSameModification(const struct stat& a, const struct stat& b) {
+  return a.st_mtime == b.st_mtime && a.st_size == b.st_size;
+}
+#endif
+}  // namespace
+
+SceneWatcher::SceneWatcher(const std::string& path)
+    : path_(path), stopping_(false) {}
+
+SceneWatcher::~SceneWatcher() {
+  stopping_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void SceneWatcher::Start(std::vector<glm::ivec4> scene) {
+  initial_scene_.swap(scene);
+  thread_ = std::thread(&SceneWatcher::Watch, this);
+}
+
+bool SceneWatcher::TakePatch(Patch* patch) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (patches_.empty()) {
+    return false;
+  }
+  *patch = std::move(patches_.front());
+  patches_.pop_front();
+  return true;
+}
+
+void SceneWatcher::Watch() {
+  scene_.Reserve(initial_scene_.size());
+  for (const glm::ivec4& position : initial_scene_) {
+    scene_.Insert(position);
+  }
+  std::vector<glm::ivec4>().swap(initial_scene_);
+  WatchFile();
+}
+
+#ifdef __linux__
+
+void SceneWatcher::WatchFile() {
+  // Watch the directory rather than the file: editors often save by
+  // renaming a new file over the old one, which a watch on the file itself
+  // would not follow.
+  size_t split = path_.find_last_of('/');
+  std::string directory = ".";
+  std::string name = path_;
+  if (split != std::string::npos) {
+    directory = path_.substr(0, std::max<size_t>(split, 1));
+    name = path_.substr(split + 1);
+  }
+
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd, directory.c_str(),
+                                  IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    perror(("Cannot watch " + path_).c_str());
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+
+  bool changed = false;
+  alignas(struct inotify_event) char events[4096];
+  while (!stopping_) {
+    struct pollfd poll_fd = {fd, POLLIN, 0};
+    int n_ready = poll(&poll_fd, 1, changed ? kSettleMs : kPollMs);
+    if (n_ready < 0) {
+      break;
+    }
+    if (n_ready == 0) {
+      if (changed) {
+        changed = false;
+        Reload();
+      }
+      continue;
+    }
+    ssize_t size = read(fd, events, sizeof(events));
+    for (ssize_t offset = 0; offset < size;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(events + offset);
+      if (event->len > 0 && name == event->name) {
+        changed = true;
+      }
+      offset += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  close(fd);
+}
+
+#else
+
+void SceneWatcher::WatchFile() {
+  // Without inotify, compare the modification time and size every poll.
+  struct stat last;
+  bool exists = GetModification(path_, &last);
+  bool changed = false;
+  while (!stopping_) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(changed ? kSettleMs : kPollMs));
+    struct stat current;
+    bool now_exists = GetModification(path_, &current);
+    if (now_exists != exists ||
+        (now_exists && !IsSameModification(current, last))) {
+      exists = now_exists;
+      last = current;
+      changed = true;
+    } else if (changed) {
+      changed = false;
+      if (exists) {
+        Reload();
+      }
+    }
+  }
+}
+
+#endif
+
+void SceneWatcher::Reload() {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<glm::ivec4> positions;
+  if (!SceneFile::Load(path_, &positions)) {
+    printf("Keeping the current scene.\n");
+    return;
+  }
+
+  Patch patch;
+  FlatIvec4Set scene;
+  scene.Reserve(positions.size());
+  for (const glm::ivec4& position : positions) {
+    scene.Insert(position);
+  }
+  scene_.ForEach([&](const glm::ivec4& position) {
+    if (!scene.Contains(position)) {
+      patch.removed.push_back(position);
+    }
+  });
+  scene.ForEach([&](const glm::ivec4& position) {
+    if (!scene_.Contains(position)) {
+      patch.added.push_back(position);
+    }
+  });
+  std::swap(scene_, scene);
+  if (patch.removed.empty() && patch.added.empty()) {
+    return;
+  }
+  patch.ms = std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - start)
+                 .count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  patches_.push_back(std::move(patch));
+}
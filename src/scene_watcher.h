@@ -0,0 +1,73 @@
+// Hot reloading of a scene file. A watcher thread waits for the file to
+// change (through inotify on Linux, by polling its modification time
+// elsewhere), parses it again and diffs the new blocks against the previous
+// version of the file, producing a patch of only the blocks that were added
+// or removed.
+//
+// Patches are relative to the previous version of the file rather than to
+// the scene on screen, starting from the blocks the file was loaded with, so
+// blocks edited at runtime, even while the scene was loading, stay as they
+// are unless the file changes them too.
+
+#ifndef SCENE_WATCHER_H_
+#define SCENE_WATCHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "ivec4_hash.h"
+
+class SceneWatcher {
+ public:
+  struct Patch {
+    // The blocks that left and joined the scene.
+    std::vector<glm::ivec4> removed;
+    std::vector<glm::ivec4> added;
+
+    // Time spent parsing and diffing the new file.
+    double ms;
+  };
+
+  explicit SceneWatcher(const std::string& path);
+
+  // Stops watching and waits for the thread.
+  ~SceneWatcher();
+
+  // Starts watching the file, given the blocks it was loaded with.
+  void Start(std::vector<glm::ivec4> scene);
+
+  // Moves the oldest patch not taken yet into patch. Returns false if there
+  // is none.
+  bool TakePatch(Patch* patch);
+
+  const std::string& GetPath() const { return path_; }
+
+ private:
+  SceneWatcher(const SceneWatcher&);
+  SceneWatcher& operator=(const SceneWatcher&);
+
+  void Watch();
+  void WatchFile();
+  void Reload();
+
+  const std::string path_;
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+
+  // Blocks of the previous version of the file, only used by the watcher
+  // thread once started.
+  std::vector<glm::ivec4> initial_scene_;
+  FlatIvec4Set scene_;
+
+  // Patches not taken yet, guarded by mutex_.
+  std::mutex mutex_;
+  std::deque<Patch> patches_;
+};
+
+#endif  // SCENE_WATCHER_H_
@@ -4,7 +4,7 @@
 //layout(location = 0) out vec4 vs_color;
 
 layout(set = 0, binding = 0) buffer cubeOutputVertices {
-  vec4 vertex_out[N_MESHES * N_VERTICES];
+  vec4 vertex_out[CHUNK_MESHES * N_VERTICES];
 };
 
 void main() {
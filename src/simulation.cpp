@@ -0,0 +1,131 @@
+#include "simulation.h"
+
+#include <cstring>
+
+#include "camera.h"
+
+namespace {
+const std::chrono::nanoseconds kTickPeriod(1000000000 / SIMULATION_TICK_RATE);
+const float kTickSeconds = 1.0f / SIMULATION_TICK_RATE;
+
+// After a stall longer than this, the simulation drops the missed ticks
+// instead of running them all back to back.
+const int kMaxCatchUpTicks = 8;
+
+// Speeds of held moves per second, matching the per-frame steps the keys
+// used to make at 60 frames per second.
+const float kMoveSpeed = 6.0f;
+const float kRollSpeed = 0.9f;
+
+float GetHoldSpeed(CameraPath::Op op) {
+  return op == CameraPath::OP_ROLL_LEFT || op == CameraPath::OP_ROLL_RIGHT
+             ? kRollSpeed
+             : kMoveSpeed;
+}
+}  // namespace
+
+Simulation::Simulation()
+    : camera_(nullptr), recorder_(nullptr), stopping_(false), n_ticks_(0) {
+  memset(held_, 0, sizeof(held_));
+}
+
+Simulation::~Simulation() { Stop(); }
+
+void Simulation::Start(Camera* camera, CameraPath* recorder) {
+  Stop();
+  camera_ = camera;
+  recorder_ = recorder;
+  memset(held_, 0, sizeof(held_));
+  n_ticks_ = 0;
+  state_.previous_view = state_.view = camera_->GetRelativeView();
+  state_.previous_eye = state_.eye = camera_->GetPrecisePosition();
+  state_.time = Clock::now();
+  state_.previous_n_inputs_applied = state_.n_inputs_applied = 0;
+  states_.Reset(state_);
+  stopping_ = false;
+  thread_ = std::thread(&Simulation::Run, this);
+}
+
+void Simulation::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  thread_.join();
+}
+
+bool Simulation::PushInput(const InputEvent& event) {
+  return inputs_.Push(event);
+}
+
+mat5 Simulation::GetView(Clock::time_point now, glm::dvec4* eye,
+                         uint64_t* n_inputs_applied) {
+  const State& state = states_.Read();
+  float t = std::chrono::duration<float>(now - state.time).count() /
+            kTickSeconds;
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  *n_inputs_applied =
+      t < 1.0f ? state.previous_n_inputs_applied : state.n_inputs_applied;
+  *eye = glm::mix(state.previous_eye, state.eye, static_cast<double>(t));
+  return mat5::lerp(state.previous_view, state.view, t);
+}
+
+void Simulation::Run() {
+  Clock::time_point next_tick = Clock::now() + kTickPeriod;
+  while (!stopping_) {
+    std::this_thread::sleep_until(next_tick);
+    const Clock::time_point now = Clock::now();
+    if (now - next_tick > kMaxCatchUpTicks * kTickPeriod) {
+      next_tick = now;
+    }
+    while (next_tick <= now && !stopping_) {
+      Tick(next_tick);
+      next_tick += kTickPeriod;
+    }
+  }
+}
+
+void Simulation::Tick(Clock::time_point time) {
+  {
+    std::unique_lock<std::mutex> lock(camera_mutex_);
+    if (recorder_ != nullptr) {
+      recorder_->SetFrame(n_ticks_);
+    }
+
+    state_.previous_n_inputs_applied = state_.n_inputs_applied;
+    InputEvent event;
+    while (inputs_.Pop(&event)) {
+      switch (event.type) {
+        case InputEvent::HOLD:
+          held_[event.op] = true;
+          break;
+        case InputEvent::RELEASE:
+          held_[event.op] = false;
+          break;
+        case InputEvent::RELEASE_ALL:
+          memset(held_, 0, sizeof(held_));
+          break;
+        case InputEvent::APPLY:
+          CameraPath::ApplyOp(event.op, event.amount, camera_);
+          break;
+      }
+      state_.n_inputs_applied = event.ordinal + 1;
+    }
+
+    for (int op = 0; op < CameraPath::N_OPS; ++op) {
+      if (held_[op]) {
+        const CameraPath::Op hold_op = static_cast<CameraPath::Op>(op);
+        CameraPath::ApplyOp(hold_op, GetHoldSpeed(hold_op) * kTickSeconds,
+                            camera_);
+      }
+    }
+
+    state_.previous_view = state_.view;
+    state_.view = camera_->GetRelativeView();
+    state_.previous_eye = state_.eye;
+    state_.eye = camera_->GetPrecisePosition();
+  }
+  state_.time = time;
+  states_.Publish(state_);
+  ++n_ticks_;
+}
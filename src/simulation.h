@@ -0,0 +1,110 @@
+// Fixed-timestep camera simulation on its own thread. Camera movement and
+// collision advance in ticks of exactly 1 / SIMULATION_TICK_RATE seconds,
+// so speeds and collision response no longer depend on the frame rate, and
+// a slow frame neither changes the motion nor delays input handling.
+//
+// Input reaches the simulation through a lock-free queue filled by the GLFW
+// callbacks. Each tick publishes the previous and the new view through a
+// triple buffer, and the renderer blends the two by how far it is past the
+// tick, so motion stays smooth at any frame rate. That places the rendered
+// view up to one tick behind the simulation. Views are published relative to
+// the eye, with the eye itself in double precision, so that blending and
+// rendering far from the world origin keep their precision.
+//
+// The camera's terrain is shared with the render thread, which edits it and
+// casts rays through it; both threads go through LockCamera() for that.
+
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "camera_path.h"
+#include "matrix.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+#define SIMULATION_TICK_RATE 120
+
+class Camera;
+
+class Simulation {
+ public:
+  // A camera input. Held moves continue every tick until released, at a
+  // speed per second; applied moves, such as mouse look, happen once.
+  struct InputEvent {
+    enum Type { HOLD, RELEASE, RELEASE_ALL, APPLY };
+    Type type;
+    CameraPath::Op op;
+    float amount;
+
+    // Position of the event in the sequence of all inputs, see InputLatency.
+    uint64_t ordinal;
+  };
+
+  Simulation();
+
+  // Stops the thread.
+  ~Simulation();
+
+  // Starts ticking the camera. When recorder is given, every tick records
+  // its camera operations as one frame of the path.
+  void Start(Camera* camera, CameraPath* recorder);
+  void Stop();
+  bool IsRunning() const { return thread_.joinable(); }
+
+  // Called by the input thread. Returns false if the queue is full.
+  bool PushInput(const InputEvent& event);
+
+  // Guards the camera while the simulation runs.
+  std::unique_lock<std::mutex> LockCamera() {
+    return std::unique_lock<std::mutex>(camera_mutex_);
+  }
+
+  // Called by the render thread. Returns the eye-relative view blended
+  // between the last two ticks for the given time, storing the blended eye
+  // position and the number of inputs the view fully reflects: those of the
+  // older tick while the blend is still partway, those of the newer one once
+  // it has reached it.
+  mat5 GetView(std::chrono::steady_clock::time_point now, glm::dvec4* eye,
+               uint64_t* n_inputs_applied);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct State {
+    mat5 previous_view;
+    mat5 view;
+    glm::dvec4 previous_eye;
+    glm::dvec4 eye;
+    Clock::time_point time;
+    uint64_t previous_n_inputs_applied;
+    uint64_t n_inputs_applied;
+  };
+
+  Simulation(const Simulation&);
+  Simulation& operator=(const Simulation&);
+
+  void Run();
+  void Tick(Clock::time_point time);
+
+  Camera* camera_;
+  CameraPath* recorder_;
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  std::mutex camera_mutex_;
+
+  SpscQueue<InputEvent, 1024> inputs_;
+  TripleBuffer<State> states_;
+
+  // Only used by the simulation thread once started.
+  bool held_[CameraPath::N_OPS];
+  State state_;
+  uint32_t n_ticks_;
+};
+
+#endif  // SIMULATION_H_
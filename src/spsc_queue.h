@@ -0,0 +1,51 @@
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Push and Pop never block or allocate; Push fails when the
+// queue is full, leaving it to the producer to drop or retry.
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t kCapacity>
+class SpscQueue {
+ public:
+  SpscQueue() : head_(0), tail_(0) {}
+
+  // Producer only. Returns false if the queue is full.
+  bool Push(const T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = (tail + 1) % kSlots;
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the queue is empty.
+  bool Pop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = slots_[head];
+    head_.store((head + 1) % kSlots, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  // One slot stays empty to tell a full queue from an empty one.
+  static const size_t kSlots = kCapacity + 1;
+
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+  T slots_[kSlots];
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+};
+
+#endif  // SPSC_QUEUE_H_
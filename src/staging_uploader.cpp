@@ -0,0 +1,198 @@
+#include "staging_uploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "wrappers/queue.h"
+
+StagingUploader::StagingUploader()
+    : device_(VK_NULL_HANDLE),
+      queue_(VK_NULL_HANDLE),
+      command_pool_(VK_NULL_HANDLE),
+      fence_(VK_NULL_HANDLE),
+      staging_(VK_NULL_HANDLE),
+      staging_data_(nullptr),
+      section_size_(0),
+      n_frames_(0),
+      frame_(0),
+      section_offset_(0),
+      read_stages_(0),
+      read_access_(0),
+      staging_used_(0) {}
+
+StagingUploader::~StagingUploader() { Clear(); }
+
+void StagingUploader::Init(std::weak_ptr<Anvil::SGPUDevice> device,
+                           VkBuffer staging, VkDeviceSize section_size,
+                           uint32_t n_frames,
+                           VkPipelineStageFlags read_stages,
+                           VkAccessFlags read_access) {
+  Clear();
+  std::shared_ptr<Anvil::SGPUDevice> device_locked(device);
+  std::shared_ptr<Anvil::Queue> queue = device_locked->get_universal_queue(0);
+  device_ = device_locked->get_device_vk();
+  queue_ = queue->get_queue();
+  staging_ = staging;
+  section_size_ = section_size;
+  n_frames_ = n_frames;
+  frame_ = n_frames;
+  section_offset_ = section_size * n_frames;
+  read_stages_ = read_stages;
+  read_access_ = read_access;
+  staging_used_ = 0;
+
+  VkCommandPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.pNext = nullptr;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                    VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = queue->get_queue_family_index();
+  vkCreateCommandPool(device_, &pool_info, nullptr, &command_pool_);
+
+  command_buffers_.resize(n_frames + 1);
+  VkCommandBufferAllocateInfo allocate_info;
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.pNext = nullptr;
+  allocate_info.commandPool = command_pool_;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = n_frames + 1;
+  vkAllocateCommandBuffers(device_, &allocate_info, command_buffers_.data());
+
+  VkFenceCreateInfo fence_info;
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.pNext = nullptr;
+  fence_info.flags = 0;
+  vkCreateFence(device_, &fence_info, nullptr, &fence_);
+}
+
+void StagingUploader::Write(VkBuffer destination, VkDeviceSize offset,
+                            const void* data, VkDeviceSize size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  while (size > 0) {
+    if (staging_used_ == section_size_) {
+      Submit();
+    }
+    const VkDeviceSize n = std::min(size, section_size_ - staging_used_);
+    const VkDeviceSize staging_offset = section_offset_ + staging_used_;
+    memcpy(staging_data_ + staging_offset, bytes, static_cast<size_t>(n));
+
+    // Writes to the same buffer share one copy command, and writes that
+    // continue the previous one extend its region.
+    if (copies_.empty() || copies_.back().destination != destination) {
+      Copy copy;
+      copy.destination = destination;
+      copy.first_region = regions_.size();
+      copy.n_regions = 0;
+      copies_.push_back(copy);
+    }
+    Copy& copy = copies_.back();
+    VkBufferCopy* last = copy.n_regions > 0 ? &regions_.back() : nullptr;
+    if (last != nullptr && last->srcOffset + last->size == staging_offset &&
+        last->dstOffset + last->size == offset) {
+      last->size += n;
+    } else {
+      VkBufferCopy region;
+      region.srcOffset = staging_offset;
+      region.dstOffset = offset;
+      region.size = n;
+      regions_.push_back(region);
+      ++copy.n_regions;
+    }
+
+    staging_used_ += n;
+    bytes += n;
+    offset += n;
+    size -= n;
+  }
+}
+
+void StagingUploader::Flush() {
+  if (!copies_.empty()) {
+    Submit();
+  }
+}
+
+void StagingUploader::BeginFrame(uint32_t n_frame) {
+  Flush();
+  frame_ = n_frame;
+  section_offset_ = section_size_ * n_frame;
+}
+
+VkCommandBuffer StagingUploader::EndFrame() {
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  if (!copies_.empty()) {
+    command_buffer = command_buffers_[frame_];
+    Record(command_buffer);
+  }
+  frame_ = n_frames_;
+  section_offset_ = section_size_ * n_frames_;
+  return command_buffer;
+}
+
+void StagingUploader::Clear() {
+  if (device_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vkQueueWaitIdle(queue_);
+  vkDestroyFence(device_, fence_, nullptr);
+  vkDestroyCommandPool(device_, command_pool_, nullptr);
+  fence_ = VK_NULL_HANDLE;
+  command_pool_ = VK_NULL_HANDLE;
+  command_buffers_.clear();
+  device_ = VK_NULL_HANDLE;
+  copies_.clear();
+  regions_.clear();
+  staging_used_ = 0;
+}
+
+// Records the queued copies and starts the section over.
+void StagingUploader::Record(VkCommandBuffer command_buffer) {
+  VkCommandBufferBeginInfo begin_info;
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pNext = nullptr;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  begin_info.pInheritanceInfo = nullptr;
+  vkBeginCommandBuffer(command_buffer, &begin_info);
+
+  // Earlier work on the queue may still read the bytes being overwritten.
+  vkCmdPipelineBarrier(command_buffer, read_stages_,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+  for (const Copy& copy : copies_) {
+    vkCmdCopyBuffer(command_buffer, staging_, copy.destination, copy.n_regions,
+                    &regions_[copy.first_region]);
+  }
+  VkMemoryBarrier barrier;
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.pNext = nullptr;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = read_access_;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       read_stages_, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  vkEndCommandBuffer(command_buffer);
+
+  copies_.clear();
+  regions_.clear();
+  staging_used_ = 0;
+}
+
+// Submits the queued copies from the command buffer for writes outside a
+// frame and waits for them, after which their section can be reused. Inside
+// a frame, this only happens when the frame's section runs full.
+void StagingUploader::Submit() {
+  VkCommandBuffer command_buffer = command_buffers_[n_frames_];
+  Record(command_buffer);
+  VkSubmitInfo submit_info;
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = nullptr;
+  submit_info.waitSemaphoreCount = 0;
+  submit_info.pWaitSemaphores = nullptr;
+  submit_info.pWaitDstStageMask = nullptr;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &command_buffer;
+  submit_info.signalSemaphoreCount = 0;
+  submit_info.pSignalSemaphores = nullptr;
+  vkQueueSubmit(queue_, 1, &submit_info, fence_);
+  vkWaitForFences(device_, 1, &fence_, VK_TRUE, UINT64_MAX);
+  vkResetFences(device_, 1, &fence_);
+}
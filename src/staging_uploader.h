@@ -0,0 +1,116 @@
+// Uploads to device-local buffers through one long-lived, persistently
+// mapped staging buffer. A write is a memcpy into the staging buffer and a
+// copy region recorded for later, instead of the staging buffer, memory
+// allocation and blocking submission that Anvil::Buffer::write makes on every
+// call for memory the host cannot map.
+//
+// Writes are collected until Flush(), which records them in one command
+// buffer, with one vkCmdCopyBuffer per destination buffer and one region per
+// write, submits it and waits for it. Writes between BeginFrame() and
+// EndFrame() are instead recorded in a command buffer of their frame, which
+// the caller submits with the frame's own commands, so that they do not
+// block the render thread.
+//
+// The staging buffer has a section for every frame in flight, reused once
+// the frame has finished, and one for writes outside a frame. When a write
+// does not fit in its section any more, the writes before it are submitted
+// and waited for first.
+
+#ifndef STAGING_UPLOADER_H_
+#define STAGING_UPLOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "wrappers/device.h"
+
+class StagingUploader {
+ public:
+  StagingUploader();
+
+  // Waits for the uploads and destroys the command pool.
+  ~StagingUploader();
+
+  // Uploads go through staging, a host coherent buffer of
+  // GetStagingSize(section_size, n_frames) bytes, and are submitted to the
+  // universal queue. Copies are ordered after earlier reads of the
+  // destinations by read_stages, and made visible to read_access in those
+  // stages.
+  void Init(std::weak_ptr<Anvil::SGPUDevice> device, VkBuffer staging,
+            VkDeviceSize section_size, uint32_t n_frames,
+            VkPipelineStageFlags read_stages, VkAccessFlags read_access);
+
+  static VkDeviceSize GetStagingSize(VkDeviceSize section_size,
+                                     uint32_t n_frames) {
+    return section_size * (n_frames + 1);
+  }
+
+  // Sets the host address of the staging buffer, which changes whenever it
+  // is mapped again.
+  void SetStagingData(unsigned char* staging_data) {
+    staging_data_ = staging_data;
+  }
+
+  // Queues a copy of size bytes from data to offset in destination.
+  void Write(VkBuffer destination, VkDeviceSize offset, const void* data,
+             VkDeviceSize size);
+
+  // Submits the queued copies and waits for them.
+  void Flush();
+
+  // Collects the following writes for frame n_frame, whose previous use must
+  // have finished on the GPU.
+  void BeginFrame(uint32_t n_frame);
+
+  // Returns the command buffer with the copies of the frame, to be submitted
+  // before the frame's commands on the same queue, or VK_NULL_HANDLE if the
+  // frame wrote nothing.
+  VkCommandBuffer EndFrame();
+
+  // Waits for the uploads and destroys the command pool.
+  void Clear();
+
+ private:
+  // The regions of one vkCmdCopyBuffer.
+  struct Copy {
+    VkBuffer destination;
+    size_t first_region;
+    uint32_t n_regions;
+  };
+
+  StagingUploader(const StagingUploader&);
+  StagingUploader& operator=(const StagingUploader&);
+
+  void Record(VkCommandBuffer command_buffer);
+  void Submit();
+
+  VkDevice device_;
+  VkQueue queue_;
+  VkCommandPool command_pool_;
+  VkFence fence_;
+
+  // One command buffer per frame, and a last one for writes outside a frame.
+  std::vector<VkCommandBuffer> command_buffers_;
+
+  VkBuffer staging_;
+  unsigned char* staging_data_;
+  VkDeviceSize section_size_;
+  uint32_t n_frames_;
+
+  // The frame collecting writes, or n_frames_ outside a frame, and the start
+  // of its section.
+  uint32_t frame_;
+  VkDeviceSize section_offset_;
+  VkPipelineStageFlags read_stages_;
+  VkAccessFlags read_access_;
+
+  // Copies not submitted yet, and the bytes of the section they use. The
+  // vectors keep their memory, so steady uploading does not allocate.
+  std::vector<Copy> copies_;
+  std::vector<VkBufferCopy> regions_;
+  VkDeviceSize staging_used_;
+};
+
+#endif  // STAGING_UPLOADER_H_
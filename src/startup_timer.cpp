@@ -0,0 +1,98 @@
+#include "startup_timer.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+typedef std::chrono::duration<double, std::milli> Milliseconds;
+}  // namespace
+
+StartupTimer* StartupTimer::GetInstance() {
+  static StartupTimer instance;
+  return &instance;
+}
+
+StartupTimer::StartupTimer() : start_(Clock::now()), presented_(false) {
+  for (int phase = 0; phase < N_PHASES; ++phase) {
+    ms_[phase] = 0.0;
+  }
+}
+
+void StartupTimer::Begin(Phase phase) { begin_[phase] = Clock::now(); }
+
+void StartupTimer::End(Phase phase) {
+  ms_[phase] += Milliseconds(Clock::now() - begin_[phase]).count();
+}
+
+void StartupTimer::MarkFirstPresent() {
+  if (presented_) {
+    return;
+  }
+  ms_[PHASE_FIRST_PRESENT] = Milliseconds(Clock::now() - start_).count();
+  presented_ = true;
+}
+
+void StartupTimer::MarkSceneLoaded() {
+  ms_[PHASE_SCENE_LOADED] = Milliseconds(Clock::now() - start_).count();
+}
+
+bool StartupTimer::AppendCsv(const std::string& path, uint64_t n_blocks,
+                             const char* render_mode) const {
+  bool write_header;
+  {
+    std::ifstream existing(path.c_str(), std::ios::ate);
+    write_header = !existing.is_open() || existing.tellg() <= 0;
+  }
+
+  FILE* out = fopen(path.c_str(), "a");
+  if (out == nullptr) {
+    fprintf(stderr, "Startup timer: could not open \"%s\"\n", path.c_str());
+    return false;
+  }
+  if (write_header) {
+    fprintf(out, "scene,blocks,render_mode");
+    for (int phase = 0; phase < N_PHASES; ++phase) {
+      fprintf(out, ",%s_ms", GetPhaseName(static_cast<Phase>(phase)));
+    }
+    fprintf(out, "\n");
+  }
+  fprintf(out, "%s,%llu,%s", scene_.c_str(),
+          static_cast<unsigned long long>(n_blocks), render_mode);
+  for (int phase = 0; phase < N_PHASES; ++phase) {
+    fprintf(out, ",%.3f", ms_[phase]);
+  }
+  fprintf(out, "\n");
+  fclose(out);
+  return true;
+}
+
+void StartupTimer::Report() const {
+  printf("Startup times (ms):");
+  for (int phase = 0; phase < N_PHASES; ++phase) {
+    printf(" %s %.1f", GetPhaseName(static_cast<Phase>(phase)), ms_[phase]);
+  }
+  printf("\n");
+}
+
+const char* StartupTimer::GetPhaseName(Phase phase) {
+  switch (phase) {
+    case PHASE_TERRAIN:
+      return "terrain";
+    case PHASE_PARSE:
+      return "parse";
+    case PHASE_VULKAN:
+      return "vulkan";
+    case PHASE_UPLOAD:
+      return "upload";
+    case PHASE_SHADERS:
+      return "shaders";
+    case PHASE_PIPELINES:
+      return "pipelines";
+    case PHASE_FIRST_PRESENT:
+      return "first_present";
+    case PHASE_SCENE_LOADED:
+      return "scene_loaded";
+    default:
+      return "unknown";
+  }
+}
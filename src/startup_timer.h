@@ -0,0 +1,67 @@
+// Wall-clock timing of the startup phases, from scene generation or parsing
+// through pipeline creation to the first presented frame and the fully loaded
+// scene. Used to track how startup scales with scene size; see --startup-csv
+// and --startup-sweep.
+
+#ifndef STARTUP_TIMER_H_
+#define STARTUP_TIMER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class StartupTimer {
+ public:
+  enum Phase {
+    PHASE_TERRAIN = 0,
+    PHASE_PARSE,
+    PHASE_VULKAN,
+    PHASE_UPLOAD,
+    PHASE_SHADERS,
+    PHASE_PIPELINES,
+    PHASE_FIRST_PRESENT,
+    PHASE_SCENE_LOADED,
+    N_PHASES
+  };
+
+  // The timer starts when the instance is first requested.
+  static StartupTimer* GetInstance();
+
+  // Phases may be entered more than once; their times add up.
+  void Begin(Phase phase);
+  void End(Phase phase);
+
+  // Records the time since startup as PHASE_FIRST_PRESENT, once.
+  void MarkFirstPresent();
+  bool HasPresented() const { return presented_; }
+
+  // Records the time since startup as PHASE_SCENE_LOADED. Scenes load in the
+  // background, so this can come long after the first present.
+  void MarkSceneLoaded();
+
+  double GetMs(Phase phase) const { return ms_[phase]; }
+
+  // Label written to the scene column, e.g. the scene file or generator.
+  void SetScene(const std::string& scene) { scene_ = scene; }
+
+  // Appends one CSV row, writing the header first if the file is empty.
+  bool AppendCsv(const std::string& path, uint64_t n_blocks,
+                 const char* render_mode) const;
+
+  void Report() const;
+
+  static const char* GetPhaseName(Phase phase);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  StartupTimer();
+
+  Clock::time_point start_;
+  Clock::time_point begin_[N_PHASES];
+  double ms_[N_PHASES];
+  bool presented_;
+  std::string scene_;
+};
+
+#endif  // STARTUP_TIMER_H_
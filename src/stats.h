@@ -0,0 +1,72 @@
+// Small, allocation-free helpers for summarizing timing samples.
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <algorithm>
+#include <cstddef>
+
+// Keeps the last N samples in a ring and reports summary statistics over them.
+// All storage is inline, so recording a sample never touches the heap.
+template <size_t N>
+class RollingStats {
+ public:
+  RollingStats() : next_(0), count_(0) {}
+
+  void Add(double sample) {
+    samples_[next_] = sample;
+    next_ = (next_ + 1) % N;
+    if (count_ < N) {
+      ++count_;
+    }
+  }
+
+  void Clear() {
+    next_ = 0;
+    count_ = 0;
+  }
+
+  size_t Count() const { return count_; }
+
+  double Last() const {
+    return count_ == 0 ? 0.0 : samples_[(next_ + N - 1) % N];
+  }
+
+  double Average() const {
+    if (count_ == 0) {
+      return 0.0;
+    }
+    double total = 0.0;
+    for (size_t i = 0; i < count_; ++i) {
+      total += samples_[i];
+    }
+    return total / count_;
+  }
+
+  double Max() const {
+    if (count_ == 0) {
+      return 0.0;
+    }
+    return *std::max_element(samples_, samples_ + count_);
+  }
+
+  // Nearest-rank percentile, p in [0, 100].
+  double Percentile(double p) const {
+    if (count_ == 0) {
+      return 0.0;
+    }
+    std::copy(samples_, samples_ + count_, scratch_);
+    size_t rank = static_cast<size_t>(p / 100.0 * (count_ - 1) + 0.5);
+    rank = std::min(rank, count_ - 1);
+    std::nth_element(scratch_, scratch_ + rank, scratch_ + count_);
+    return scratch_[rank];
+  }
+
+ private:
+  double samples_[N];
+  mutable double scratch_[N];
+  size_t next_;
+  size_t count_;
+};
+
+#endif  // STATS_H_
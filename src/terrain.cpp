@@ -5,7 +5,7 @@
 #include "perlin.h"
 #include "tetrahedron.h"
 #include <iostream>
-#include "openSimplex\open-simplex-noise.h"
+#include "openSimplex/open-simplex-noise.h"
 
 /**
  *	Initialize a block at the given integer coordinates.
@@ -26,6 +26,10 @@ Terrain::Chunk::Chunk(glm::ivec4 c, float persistance, float frequency, int nois
 	int ySize = dimensions_.y;
 	int zSize = dimensions_.z;
 	int wSize = dimensions_.w;
+	const size_t n_blocks = static_cast<size_t>(std::max(xSize, 0)) *
+		std::max(ySize, 0) * std::max(zSize, 0) * std::max(wSize, 0);
+	blocks_.reserve(n_blocks);
+	block_index_.Reserve(n_blocks);
 	for (int x = 0; x < xSize; ++x) {
 		for (int y = 0; y < ySize; ++y) {
 			for (int z = 0; z < zSize; ++z) {
@@ -46,10 +50,11 @@ Terrain::Chunk::Chunk(glm::ivec4 c, float persistance, float frequency, int nois
 						val = open_simplex_noise4(ctx, (double)x / FEATURE_SIZE, (double)y / FEATURE_SIZE,
 							(double)z / FEATURE_SIZE, (double)w / FEATURE_SIZE);
 					}
+					block_index_.Insert(n_coord, static_cast<uint32_t>(blocks_.size()));
 					if (val > 0) {
-						blocks_.emplace(n_coord, Terrain::Block(n_coord, 1));
+						blocks_.push_back(Terrain::Block(n_coord, 1));
 					} else {
-						blocks_.emplace(n_coord, Terrain::Block(n_coord, 0));
+						blocks_.push_back(Terrain::Block(n_coord, 0));
 					}
 				}
 			}
@@ -58,26 +63,19 @@ Terrain::Chunk::Chunk(glm::ivec4 c, float persistance, float frequency, int nois
 }
 
 Terrain::Block* Terrain::Chunk::GetBlock(glm::ivec4 c) {
-	if (blocks_.count(c) > 0) {
-		return &blocks_.at(c);
-	}
+	const uint32_t* index = block_index_.Find(c);
+	return index != nullptr ? &blocks_[*index] : nullptr;
 }
 
+/**
+ *	Blocks were generated in x, y, z, w order, so they are returned in that
+ *	order too.
+ */
 std::vector<Terrain::Block*> Terrain::Chunk::GetAllBlocks() {
 	std::vector<Terrain::Block*> outputBlocks;
-	int xSize = dimensions_.x;
-	int ySize = dimensions_.y;
-	int zSize = dimensions_.z;
-	int wSize = dimensions_.w;
-	for (int x = 0; x < xSize; ++x) {
-		for (int y = 0; y < ySize; ++y) {
-			for (int z = 0; z < zSize; ++z) {
-				for (int w = 0; w < wSize; ++w) {
-					glm::ivec4 n_coord(x, y, z, w);
-					outputBlocks.push_back(&blocks_.at(n_coord));
-				}
-			}
-		}
+	outputBlocks.reserve(blocks_.size());
+	for (Terrain::Block& block : blocks_) {
+		outputBlocks.push_back(&block);
 	}
 	return outputBlocks;
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+// Converts scenes between the text format and the binary .t4d format.
+//
+// Use: 4d_scene_convert [--raw] <input> <output>
+//
+// The input format is detected from its contents. Outputs ending in ".t4d"
+// are written in the binary format, anything else as text. --raw adds the
+// raw int16 block to .t4d files, which loads without decoding but takes
+// 8 bytes per block.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "scene_binary.h"
+#include "scene_file.h"
+
+namespace {
+bool EndsWith(const std::string& s, const char* suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool write_raw = false;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--raw") == 0) {
+      write_raw = true;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    printf("Use: %s [--raw] <input> <output>\n", argv[0]);
+    printf("Outputs ending in .t4d are binary scenes, others text scenes.\n");
+    return 1;
+  }
+
+  std::vector<glm::ivec4> positions;
+  if (!SceneFile::Load(paths[0], &positions)) {
+    return 1;
+  }
+
+  if (EndsWith(paths[1], ".t4d")) {
+    std::string error;
+    if (!SceneBinary::Write(paths[1], positions, write_raw, &error)) {
+      fprintf(stderr, "%s: %s\n", paths[1].c_str(), error.c_str());
+      return 1;
+    }
+  } else if (!SceneFile::Write(paths[1], positions)) {
+    return 1;
+  }
+  printf("Converted %zu blocks from \"%s\" to \"%s\".\n", positions.size(),
+         paths[0].c_str(), paths[1].c_str());
+  return 0;
+}
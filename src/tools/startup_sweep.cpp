@@ -0,0 +1,81 @@
+// Measures the viewer's startup across scene sizes and both render modes.
+//
+// Use: 4d_startup_sweep <4d_explore> [csv file] [width height]
+//
+// Every run is a separate headless process of the viewer rendering one
+// frame, so each starts cold and appends its phase times to the CSV file
+// (startup.csv by default) through --startup-csv. Generated scenes measure
+// terrain generation; synthetic scene files of the same size measure
+// parsing. The viewer runs in the current directory, where it finds its
+// shaders.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+// Writes a dense hypercube of side^4 tesseracts in the scene file format.
+bool WriteSyntheticScene(const std::string& path, int side) {
+  FILE* out = fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    return false;
+  }
+  for (int x = 0; x < side; ++x) {
+    for (int y = 0; y < side; ++y) {
+      for (int w = 0; w < side; ++w) {
+        for (int z = 0; z < side; ++z) {
+          fprintf(out, "%d %d %d %d\n", x, y, w, z);
+        }
+      }
+    }
+  }
+  fclose(out);
+  return true;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2 && argc != 3 && argc != 5) {
+    printf("Use: %s <4d_explore> [csv file] [width height]\n", argv[0]);
+    return 1;
+  }
+  const std::string executable = argv[1];
+  const std::string csv = argc >= 3 ? argv[2] : "startup.csv";
+  const std::string size = argc == 5 ? std::string(argv[3]) + " " + argv[4]
+                                     : std::string("1280 720");
+  const int sides[] = {1, 4, 8, 16, 24, 32, 40};
+  const char* modes[] = {"", " --wireframe"};
+  remove(csv.c_str());
+
+  int n_failed = 0;
+  for (int side : sides) {
+    const std::string scene_file =
+        "startup_sweep_" + std::to_string(side) + ".txt";
+    if (!WriteSyntheticScene(scene_file, side)) {
+      fprintf(stderr, "Could not write \"%s\"\n", scene_file.c_str());
+      return 1;
+    }
+    const std::string side_args = " 0.5 2.0 " + std::to_string(side) + " " +
+                                  std::to_string(side) + " " +
+                                  std::to_string(side) + " " +
+                                  std::to_string(side);
+    const std::string scenes[] = {scene_file, "PERLIN" + side_args};
+
+    for (const std::string& scene : scenes) {
+      for (const char* mode : modes) {
+        const std::string command = "\"" + executable +
+                                    "\" --headless=1 --startup-csv=\"" + csv +
+                                    "\"" + mode + " " + size + " " + scene;
+        printf("Startup sweep: %s\n", command.c_str());
+        fflush(stdout);
+        if (system(command.c_str()) != 0) {
+          printf("Startup sweep: run failed.\n");
+          ++n_failed;
+        }
+      }
+    }
+    remove(scene_file.c_str());
+  }
+  printf("Startup sweep written to \"%s\"\n", csv.c_str());
+  return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Lock-free hand-over of the latest value from one writer thread to one
+// reader thread. The writer fills a back slot and swaps it with the middle
+// one; the reader swaps the middle slot with its front slot whenever a newer
+// value has been published. Neither side ever waits, and the reader always
+// sees a complete value.
+//
+// Two slots are not enough without locking: the writer could start on the
+// slot the reader is still copying from.
+
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+ public:
+  // Every slot starts out as initial, so reads before the first Publish()
+  // return it.
+  explicit TripleBuffer(const T& initial = T())
+      : middle_(1), back_(0), front_(2) {
+    slots_[0] = slots_[1] = slots_[2] = initial;
+  }
+
+  // Writer only.
+  void Publish(const T& value) {
+    slots_[back_] = value;
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // Reader only. Returns the most recently published value.
+  const T& Read() {
+    if ((middle_.load(std::memory_order_relaxed) & kFresh) != 0) {
+      front_ =
+          middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    return slots_[front_];
+  }
+
+  // Not thread-safe: only for use while neither side is running.
+  void Reset(const T& value) {
+    slots_[0] = slots_[1] = slots_[2] = value;
+    middle_.store(1, std::memory_order_relaxed);
+    back_ = 0;
+    front_ = 2;
+  }
+
+ private:
+  static const int kIndexMask = 3;
+  static const int kFresh = 4;
+
+  TripleBuffer(const TripleBuffer&);
+  TripleBuffer& operator=(const TripleBuffer&);
+
+  T slots_[3];
+  std::atomic<int> middle_;
+  int back_;
+  int front_;
+};
+
+#endif  // TRIPLE_BUFFER_H_
@@ -0,0 +1,279 @@
+#include "voxel_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace {
+// Threads get at least this many rays, so small batches are not split
+// across threads that cost more to start than the rays do to cast.
+const size_t kMinRaysPerThread = 256;
+
+void CastRange(const VoxelGrid* grid, const VoxelGrid::Ray* rays,
+               size_t n_rays, float max_distance, VoxelGrid::RayHit* hits,
+               size_t* n_hits) {
+  size_t n = 0;
+  for (size_t i = 0; i < n_rays; ++i) {
+    if (grid->CastRay(rays[i], max_distance, &hits[i])) {
+      ++n;
+    }
+  }
+  *n_hits = n;
+}
+}  // namespace
+
+VoxelGrid::VoxelGrid() : bounds_min_(0), bounds_max_(0), n_cells_(0) {}
+
+void VoxelGrid::Clear() {
+  bricks_.clear();
+  brick_index_.Clear();
+  bounds_min_ = glm::ivec4(0);
+  bounds_max_ = glm::ivec4(0);
+  n_cells_ = 0;
+}
+
+bool VoxelGrid::Set(const glm::ivec4& cell) {
+  const glm::ivec4 brick = GetBrick(cell);
+  uint32_t* index = brick_index_.Find(brick);
+  if (index == nullptr) {
+    brick_index_.Insert(brick, static_cast<uint32_t>(bricks_.size()));
+    bricks_.push_back(Brick());
+    memset(bricks_.back().bits, 0, sizeof(bricks_.back().bits));
+    index = brick_index_.Find(brick);
+
+    const glm::ivec4 low = brick << kBrickShift;
+    const glm::ivec4 high = low + ((1 << kBrickShift) - 1);
+    if (bricks_.size() == 1) {
+      bounds_min_ = low;
+      bounds_max_ = high;
+    } else {
+      bounds_min_ = glm::min(bounds_min_, low);
+      bounds_max_ = glm::max(bounds_max_, high);
+    }
+  }
+  const int bit = GetBit(cell);
+  uint64_t& word = bricks_[*index].bits[bit >> 6];
+  const uint64_t mask = 1ull << (bit & 63);
+  if ((word & mask) != 0) {
+    return false;
+  }
+  word |= mask;
+  ++n_cells_;
+  return true;
+}
+
+bool VoxelGrid::Reset(const glm::ivec4& cell) {
+  const uint32_t* index = brick_index_.Find(GetBrick(cell));
+  if (index == nullptr) {
+    return false;
+  }
+  const int bit = GetBit(cell);
+  uint64_t& word = bricks_[*index].bits[bit >> 6];
+  const uint64_t mask = 1ull << (bit & 63);
+  if ((word & mask) == 0) {
+    return false;
+  }
+  word &= ~mask;
+  --n_cells_;
+  return true;
+}
+
+bool VoxelGrid::IsSet(const glm::ivec4& cell) const {
+  const uint64_t* bits = FindBits(GetBrick(cell));
+  if (bits == nullptr) {
+    return false;
+  }
+  const int bit = GetBit(cell);
+  return (bits[bit >> 6] >> (bit & 63) & 1) != 0;
+}
+
+bool VoxelGrid::CastRay(const Ray& ray, float max_distance,
+                        RayHit* hit) const {
+  const float infinity = std::numeric_limits<float>::infinity();
+  hit->distance = infinity;
+  const float length = glm::length(ray.direction);
+  if (bricks_.empty() || !(length > 0.0f)) {
+    return false;
+  }
+  const glm::vec4 direction = ray.direction / length;
+
+  // Clip the ray to the box of allocated bricks, outside of which every
+  // cell is empty, and start it where it enters the box.
+  float t = 0.0f;
+  int entry_axis = -1;
+  for (int i = 0; i < 4; ++i) {
+    const float low = bounds_min_[i] - 0.5f;
+    const float high = bounds_max_[i] + 0.5f;
+    if (direction[i] == 0.0f) {
+      if (ray.origin[i] < low || ray.origin[i] >= high) {
+        return false;
+      }
+      continue;
+    }
+    const float t_low = (low - ray.origin[i]) / direction[i];
+    const float t_high = (high - ray.origin[i]) / direction[i];
+    const float t_near = std::min(t_low, t_high);
+    if (t_near > t) {
+      t = t_near;
+      entry_axis = i;
+    }
+    max_distance = std::min(max_distance, std::max(t_low, t_high));
+  }
+  if (t > max_distance) {
+    return false;
+  }
+  const glm::vec4 origin = ray.origin + direction * t;
+
+  // next_t is the distance at which the ray crosses the next cell boundary
+  // on each axis, and delta_t the distance between boundaries.
+  glm::ivec4 cell(glm::floor(origin + 0.5f));
+  glm::ivec4 step;
+  glm::vec4 next_t;
+  glm::vec4 delta_t;
+  glm::ivec4 normal(0);
+  for (int i = 0; i < 4; ++i) {
+    step[i] = direction[i] > 0.0f ? 1 : -1;
+    if (direction[i] == 0.0f) {
+      next_t[i] = infinity;
+      delta_t[i] = infinity;
+    } else {
+      const float boundary = cell[i] + 0.5f * step[i];
+      next_t[i] = t + (boundary - origin[i]) / direction[i];
+      delta_t[i] = std::abs(1.0f / direction[i]);
+    }
+  }
+  if (entry_axis >= 0) {
+    // Rounding may leave the entry point just outside the box; the cells
+    // there are empty, so the walk below only takes an extra step.
+    normal[entry_axis] = -step[entry_axis];
+  }
+
+  glm::ivec4 brick = GetBrick(cell);
+  const uint64_t* bits = FindBits(brick);
+  for (;;) {
+    if (bits == nullptr) {
+      // Leave the empty brick in one jump: find the axis whose brick face
+      // the ray crosses first, and bring the other axes up to that point.
+      int axis = 0;
+      int exit_cell = 0;
+      float exit_t = infinity;
+      for (int i = 0; i < 4; ++i) {
+        if (next_t[i] == infinity) {
+          continue;
+        }
+        const int last = (brick[i] << kBrickShift) +
+                         (step[i] > 0 ? (1 << kBrickShift) - 1 : 0);
+        const float t_i = next_t[i] + std::abs(last - cell[i]) * delta_t[i];
+        if (t_i < exit_t) {
+          exit_t = t_i;
+          exit_cell = last + step[i];
+          axis = i;
+        }
+      }
+      if (exit_t > max_distance) {
+        return false;
+      }
+      for (int i = 0; i < 4; ++i) {
+        while (i != axis && next_t[i] < exit_t) {
+          cell[i] += step[i];
+          next_t[i] += delta_t[i];
+        }
+      }
+      cell[axis] = exit_cell;
+      next_t[axis] = exit_t + delta_t[axis];
+      normal = glm::ivec4(0);
+      normal[axis] = -step[axis];
+      t = exit_t;
+    } else {
+      const int bit = GetBit(cell);
+      if ((bits[bit >> 6] >> (bit & 63) & 1) != 0) {
+        hit->cell = cell;
+        hit->normal = normal;
+        hit->distance = t;
+        return true;
+      }
+      int axis = 0;
+      for (int i = 1; i < 4; ++i) {
+        if (next_t[i] < next_t[axis]) {
+          axis = i;
+        }
+      }
+      if (next_t[axis] > max_distance) {
+        return false;
+      }
+      t = next_t[axis];
+      cell[axis] += step[axis];
+      next_t[axis] += delta_t[axis];
+      normal = glm::ivec4(0);
+      normal[axis] = -step[axis];
+      if ((cell[axis] >> kBrickShift) == brick[axis]) {
+        continue;
+      }
+    }
+    brick = GetBrick(cell);
+    bits = FindBits(brick);
+  }
+}
+
+size_t VoxelGrid::CastRays(const Ray* rays, size_t n_rays, float max_distance,
+                           RayHit* hits, unsigned n_threads) const {
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t n_ranges = std::min<size_t>(n_threads, n_rays / kMinRaysPerThread);
+  n_ranges = std::max<size_t>(n_ranges, 1);
+
+  std::vector<size_t> n_hits(n_ranges);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < n_ranges; ++i) {
+    const size_t begin = n_rays * i / n_ranges;
+    const size_t end = n_rays * (i + 1) / n_ranges;
+    threads.push_back(std::thread(CastRange, this, rays + begin, end - begin,
+                                  max_distance, hits + begin, &n_hits[i]));
+  }
+  CastRange(this, rays, n_rays / n_ranges, max_distance, hits, &n_hits[0]);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  size_t total = 0;
+  for (size_t n : n_hits) {
+    total += n;
+  }
+  return total;
+}
+
+bool VoxelGrid::HasLineOfSight(const glm::vec4& from,
+                               const glm::vec4& to) const {
+  Ray ray;
+  ray.origin = from;
+  ray.direction = to - from;
+  RayHit hit;
+  if (!CastRay(ray, glm::length(ray.direction), &hit)) {
+    return true;
+  }
+  return hit.cell == glm::ivec4(glm::floor(to + 0.5f));
+}
+
+const uint64_t* VoxelGrid::FindBits(const glm::ivec4& brick) const {
+  const uint32_t* index = brick_index_.Find(brick);
+  return index != nullptr ? bricks_[*index].bits : nullptr;
+}
+
+VoxelGrid::Cursor::Cursor(const VoxelGrid& grid)
+    : grid_(grid), brick_(0), bits_(grid.FindBits(brick_)) {}
+
+bool VoxelGrid::Cursor::IsSet(const glm::ivec4& cell) {
+  const glm::ivec4 brick = GetBrick(cell);
+  if (brick != brick_) {
+    brick_ = brick;
+    bits_ = grid_.FindBits(brick);
+  }
+  if (bits_ == nullptr) {
+    return false;
+  }
+  const int bit = GetBit(cell);
+  return (bits_[bit >> 6] >> (bit & 63) & 1) != 0;
+}
@@ -0,0 +1,114 @@
+// Occupancy of the unit cells of 4D space, for collision and ray queries
+// that test many neighbouring cells. Cells are grouped into bricks of 8^4,
+// each a dense 512-byte bitmask, and bricks are found through a flat hash
+// map from brick coordinates. A dense 40^4 scene thus takes 625 bricks
+// instead of 2.5 million hash entries, and a cursor that remembers its last
+// brick answers most lookups of a traversal with a single bit test.
+//
+// Cell c covers [c - 0.5, c + 0.5) on every axis, like the blocks of the
+// scene, which are centered on integer coordinates.
+
+#ifndef VOXEL_GRID_H_
+#define VOXEL_GRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "ivec4_hash.h"
+
+class VoxelGrid {
+ public:
+  VoxelGrid();
+
+  void Clear();
+
+  // Number of occupied cells.
+  size_t GetCount() const { return n_cells_; }
+
+  // Marks a cell occupied or empty. Returns true if that changed it.
+  bool Set(const glm::ivec4& cell);
+  bool Reset(const glm::ivec4& cell);
+
+  bool IsSet(const glm::ivec4& cell) const;
+
+  struct Ray {
+    glm::vec4 origin;
+    glm::vec4 direction;
+  };
+
+  struct RayHit {
+    // The occupied cell, and the unit normal of the face the ray entered it
+    // through, which points back at the ray. The normal is zero when the ray
+    // starts inside the cell.
+    glm::ivec4 cell;
+    glm::ivec4 normal;
+
+    // Distance from the origin to the entry point, or infinity for a miss.
+    float distance;
+  };
+
+  // Walks the cells along a ray in order (Amanatides and Woo's traversal
+  // with four axes), jumping over whole bricks that hold no cells. Returns
+  // true if the ray enters an occupied cell within max_distance. The
+  // direction need not be normalized.
+  bool CastRay(const Ray& ray, float max_distance, RayHit* hit) const;
+
+  // Casts n_rays rays on n_threads threads, or one per core when that is 0.
+  // Returns the number of rays that hit; misses get an infinite distance.
+  size_t CastRays(const Ray* rays, size_t n_rays, float max_distance,
+                  RayHit* hits, unsigned n_threads = 0) const;
+
+  // Returns true if the segment from one point to the other crosses no
+  // occupied cell, apart from the cell holding to itself.
+  bool HasLineOfSight(const glm::vec4& from, const glm::vec4& to) const;
+
+  // Lookups for a run of nearby cells. The grid must not change while a
+  // cursor is in use.
+  class Cursor {
+   public:
+    explicit Cursor(const VoxelGrid& grid);
+
+    bool IsSet(const glm::ivec4& cell);
+
+   private:
+    const VoxelGrid& grid_;
+    glm::ivec4 brick_;
+    const uint64_t* bits_;
+  };
+
+ private:
+  static const int kBrickShift = 3;
+  static const int kBrickWords = 64;
+
+  struct Brick {
+    uint64_t bits[kBrickWords];
+  };
+
+  static glm::ivec4 GetBrick(const glm::ivec4& cell) {
+    return glm::ivec4(cell.x >> kBrickShift, cell.y >> kBrickShift,
+                      cell.z >> kBrickShift, cell.w >> kBrickShift);
+  }
+
+  // Index of a cell's bit within its brick.
+  static int GetBit(const glm::ivec4& cell) {
+    const int mask = (1 << kBrickShift) - 1;
+    return (cell.x & mask) | (cell.y & mask) << kBrickShift |
+           (cell.z & mask) << (2 * kBrickShift) |
+           (cell.w & mask) << (3 * kBrickShift);
+  }
+
+  const uint64_t* FindBits(const glm::ivec4& brick) const;
+
+  // Bricks are kept once allocated, even when they empty again.
+  std::vector<Brick> bricks_;
+  FlatIvec4Map<uint32_t> brick_index_;
+
+  // First and last cell of the box around all bricks.
+  glm::ivec4 bounds_min_;
+  glm::ivec4 bounds_max_;
+  size_t n_cells_;
+};
+
+#endif  // VOXEL_GRID_H_